@@ -0,0 +1,340 @@
+#include "Adpcm.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+//(the AVX2 build runs the same SSE2 kernel, but looks up step sizes with AVX2's gather)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ADPCM_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ADPCM_SSE2
+#endif
+
+//the standard IMA-ADPCM tables:
+static const int32_t StepTable[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+	253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+	1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+	3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+	12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+static const int32_t IndexTable[16] = {
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+//the signed change to the predictor that 'nibble' means at step index 'index':
+static inline int32_t difference(int32_t index, uint32_t nibble) {
+	int32_t s = StepTable[index];
+	int32_t diff = s >> 3;
+	if (nibble & 4) diff += s;
+	if (nibble & 2) diff += s >> 1;
+	if (nibble & 1) diff += s >> 2;
+	return (nibble & 8) ? -diff : diff;
+}
+
+//advance 'state' by one nibble:
+static inline void step(Adpcm::State &state, uint32_t nibble) {
+	state.predictor = std::max(-32768, std::min(32767, state.predictor + difference(state.index, nibble)));
+	state.index = std::max(0, std::min(88, state.index + IndexTable[nibble]));
+}
+
+std::vector< uint8_t > Adpcm::encode(int16_t const *samples, uint32_t frames) {
+	uint32_t block_count = (frames + BlockFrames - 1) / BlockFrames;
+	std::vector< uint8_t > blocks(block_count * BlockBytes, 0);
+	State state[2];
+	for (uint32_t b = 0; b < block_count; ++b) {
+		uint8_t *block = &blocks[b * BlockBytes];
+		for (uint32_t c = 0; c < 2; ++c) {
+			int16_t predictor = int16_t(state[c].predictor);
+			std::memcpy(block + 4 * c, &predictor, 2);
+			block[4 * c + 2] = uint8_t(state[c].index);
+		}
+		for (uint32_t c = 0; c < 2; ++c) {
+			uint8_t *nibbles = block + 8 + c * (BlockFrames / 2);
+			for (uint32_t i = 0; i < BlockFrames && b * BlockFrames + i < frames; ++i) {
+				int32_t target = samples[2 * (b * BlockFrames + i) + c];
+				//pick the nibble whose step lands nearest the target:
+				int32_t s = StepTable[state[c].index];
+				int32_t diff = target - state[c].predictor;
+				uint32_t nibble = 0;
+				if (diff < 0) {
+					nibble = 8;
+					diff = -diff;
+				}
+				if (diff >= s) { nibble |= 4; diff -= s; }
+				s >>= 1;
+				if (diff >= s) { nibble |= 2; diff -= s; }
+				s >>= 1;
+				if (diff >= s) { nibble |= 1; }
+				step(state[c], nibble);
+				nibbles[i / 2] |= uint8_t(nibble << (4 * (i % 2)));
+			}
+		}
+	}
+	return blocks;
+}
+
+//decoding by table: the signed step for every (step index, nibble) pair, and the step index that follows;
+// this leaves one load, one add and one clamp on each channel's serial dependency chain:
+namespace {
+struct DecodeTables {
+	DecodeTables() {
+		for (int32_t index = 0; index < 89; ++index) {
+			for (uint32_t nibble = 0; nibble < 16; ++nibble) {
+				diff[index][nibble] = difference(index, nibble);
+				next[index][nibble] = uint8_t(std::max(0, std::min(88, index + IndexTable[nibble])));
+			}
+			step[index] = int16_t(StepTable[index]);
+		}
+	}
+	int32_t diff[89][16];
+	uint8_t next[89][16];
+	int16_t step[89]; //(StepTable as 16-bit, for the SIMD kernel)
+};
+}
+static const DecodeTables tables;
+
+//reset 'state' from the header of the block at 'block':
+static inline void start_block(uint8_t const *block, Adpcm::State state[2]) {
+	for (uint32_t c = 0; c < 2; ++c) {
+		int16_t predictor;
+		std::memcpy(&predictor, block + 4 * c, 2);
+		state[c].predictor = predictor;
+		state[c].index = std::min< int32_t >(88, block[4 * c + 2]);
+	}
+}
+
+void Adpcm::decode(uint8_t const *blocks, uint32_t first, uint32_t count, State state[2], int16_t *out) {
+	uint32_t frame = first;
+	uint32_t end = first + count;
+	while (frame < end) {
+		uint32_t b = frame / BlockFrames;
+		uint32_t i = frame % BlockFrames;
+		uint32_t run = std::min(end - frame, BlockFrames - i);
+		uint8_t const *block = blocks + size_t(b) * BlockBytes;
+		if (i == 0) start_block(block, state);
+		//both channels at once, so their dependency chains overlap:
+		uint8_t const *left = block + 8;
+		uint8_t const *right = left + BlockFrames / 2;
+		int32_t lp = state[0].predictor, li = state[0].index;
+		int32_t rp = state[1].predictor, ri = state[1].index;
+		for (uint32_t k = i; k < i + run; ++k) {
+			uint32_t shift = 4 * (k % 2);
+			uint32_t ln = (left[k / 2] >> shift) & 0xf;
+			uint32_t rn = (right[k / 2] >> shift) & 0xf;
+			lp = std::max(-32768, std::min(32767, lp + tables.diff[li][ln]));
+			rp = std::max(-32768, std::min(32767, rp + tables.diff[ri][rn]));
+			li = tables.next[li][ln];
+			ri = tables.next[ri][rn];
+			out[0] = int16_t(lp);
+			out[1] = int16_t(rp);
+			out += 2;
+		}
+		state[0].predictor = lp;
+		state[0].index = li;
+		state[1].predictor = rp;
+		state[1].index = ri;
+		frame += run;
+	}
+}
+
+void Adpcm::decode_scalar(Stream const *streams, uint32_t count) {
+	for (uint32_t s = 0; s < count; ++s) {
+		decode(streams[s].blocks, streams[s].first, streams[s].count, streams[s].state, streams[s].out);
+	}
+}
+
+#if defined(ADPCM_SSE2)
+//Each channel's step index only depends on its nibbles, so that chain is plain 16-bit arithmetic,
+// and with the indices known up front the step sizes are one flat pass of table lookups (SSE2 has
+// no gather; AVX2's does them as the indices are made). The change to the predictor can need 17 bits, so it is applied as two parts of the
+// same sign that fit in 16 each, which saturating adds then clamp exactly.
+void Adpcm::decode(Stream const *streams, uint32_t count) {
+	const uint32_t Lanes = 8; //channels per register: four stereo streams
+	const uint32_t Run = 256; //most frames decoded per pass (sizes the buffers below)
+	static const uint8_t Silence[BlockFrames / 2] = { 0 }; //(nibbles for lanes with no stream)
+
+	const __m128i One = _mm_set1_epi16(1), Two = _mm_set1_epi16(2), Three = _mm_set1_epi16(3);
+	const __m128i Four = _mm_set1_epi16(4), Six = _mm_set1_epi16(6), Seven = _mm_set1_epi16(7);
+	const __m128i Eight = _mm_set1_epi16(8), Fifteen = _mm_set1_epi16(15), MaxIndex = _mm_set1_epi16(88);
+	const __m128i Zero = _mm_setzero_si128(), Ones = _mm_set1_epi16(-1);
+
+	//[frame][lane]:
+	alignas(16) int16_t nibbles[Run * Lanes];
+	alignas(16) int16_t steps[Run * Lanes]; //(holds step indices until they are looked up)
+	alignas(16) int16_t decoded[Run * Lanes];
+	alignas(16) int16_t predictor[Lanes], index[Lanes];
+
+	for (uint32_t g = 0; g < count; g += Lanes / 2) {
+		Stream const *group = streams + g;
+		uint32_t size = std::min(Lanes / 2, count - g);
+		uint32_t done[Lanes / 2] = { 0, 0, 0, 0 };
+		while (true) {
+			//the longest run every unfinished stream can decode within its current block:
+			uint32_t run = Run;
+			bool active[Lanes / 2] = { false, false, false, false };
+			bool busy = false;
+			for (uint32_t s = 0; s < size; ++s) {
+				Stream const &stream = group[s];
+				if (done[s] == stream.count) continue;
+				active[s] = busy = true;
+				uint32_t i = (stream.first + done[s]) % BlockFrames;
+				run = std::min(run, std::min(stream.count - done[s], BlockFrames - i));
+			}
+			if (!busy) break;
+
+			//each lane's starting state and nibbles (streams that are finished decode silence):
+			uint8_t const *src[Lanes];
+			uint32_t start[Lanes];
+			for (uint32_t l = 0; l < Lanes; ++l) {
+				uint32_t s = l / 2, c = l % 2;
+				src[l] = Silence;
+				start[l] = 0;
+				predictor[l] = 0;
+				index[l] = 0;
+				if (!active[s]) continue;
+				Stream const &stream = group[s];
+				uint32_t frame = stream.first + done[s];
+				uint8_t const *block = stream.blocks + size_t(frame / BlockFrames) * BlockBytes;
+				start[l] = frame % BlockFrames;
+				if (start[l] == 0 && c == 0) start_block(block, stream.state);
+				src[l] = block + 8 + c * (BlockFrames / 2);
+				predictor[l] = int16_t(stream.state[c].predictor);
+				index[l] = int16_t(stream.state[c].index);
+			}
+			uint32_t k = 0;
+			//16 frames at a time: 8 bytes from each lane, transposed so each register holds two bytes' rows
+			// (a lane starting on a high nibble takes its bytes shifted along by a nibble):
+			for (; k + 16 <= run; k += 16) {
+				__m128i r[Lanes];
+				for (uint32_t l = 0; l < Lanes; ++l) {
+					uint8_t const *at = src[l] + (start[l] + k) / 2;
+					uint64_t bits;
+					std::memcpy(&bits, at, 8);
+					if (start[l] % 2) bits = (bits >> 4) | (uint64_t(at[8]) << 60);
+					r[l] = _mm_loadl_epi64(reinterpret_cast< __m128i const * >(&bits));
+				}
+				__m128i a0 = _mm_unpacklo_epi8(r[0], r[1]), a1 = _mm_unpacklo_epi8(r[2], r[3]);
+				__m128i a2 = _mm_unpacklo_epi8(r[4], r[5]), a3 = _mm_unpacklo_epi8(r[6], r[7]);
+				__m128i b0 = _mm_unpacklo_epi16(a0, a1), b1 = _mm_unpackhi_epi16(a0, a1);
+				__m128i b2 = _mm_unpacklo_epi16(a2, a3), b3 = _mm_unpackhi_epi16(a2, a3);
+				__m128i rows[4] = {
+					_mm_unpacklo_epi32(b0, b2), _mm_unpackhi_epi32(b0, b2),
+					_mm_unpacklo_epi32(b1, b3), _mm_unpackhi_epi32(b1, b3)
+				};
+				for (uint32_t j = 0; j < 4; ++j) {
+					__m128i lo = _mm_unpacklo_epi8(rows[j], Zero), hi = _mm_unpackhi_epi8(rows[j], Zero);
+					__m128i *out = reinterpret_cast< __m128i * >(nibbles + (k + 4 * j) * Lanes);
+					_mm_store_si128(out + 0, _mm_and_si128(lo, Fifteen));
+					_mm_store_si128(out + 1, _mm_srli_epi16(lo, 4));
+					_mm_store_si128(out + 2, _mm_and_si128(hi, Fifteen));
+					_mm_store_si128(out + 3, _mm_srli_epi16(hi, 4));
+				}
+			}
+			for (; k < run; ++k) {
+				for (uint32_t l = 0; l < Lanes; ++l) {
+					uint32_t i = start[l] + k;
+					nibbles[k * Lanes + l] = int16_t((src[l][i / 2] >> (4 * (i % 2))) & 0xf);
+				}
+			}
+
+			//step indices (IndexTable as arithmetic: -1 if (n & 7) < 4, else 2 * (n & 7) - 6):
+			__m128i x = _mm_load_si128(reinterpret_cast< __m128i const * >(index));
+			for (k = 0; k < run; ++k) {
+#if defined(__AVX2__)
+				__m256i step = _mm256_i32gather_epi32(StepTable, _mm256_cvtepi16_epi32(x), 4);
+				_mm_store_si128(reinterpret_cast< __m128i * >(steps + k * Lanes),
+					_mm_packs_epi32(_mm256_castsi256_si128(step), _mm256_extracti128_si256(step, 1)));
+#else
+				_mm_store_si128(reinterpret_cast< __m128i * >(steps + k * Lanes), x);
+#endif
+				__m128i low = _mm_and_si128(_mm_load_si128(reinterpret_cast< __m128i const * >(nibbles + k * Lanes)), Seven);
+				__m128i up = _mm_cmpgt_epi16(low, Three);
+				__m128i adjust = _mm_or_si128(_mm_and_si128(up, _mm_sub_epi16(_mm_add_epi16(low, low), Six)), _mm_andnot_si128(up, Ones));
+				x = _mm_min_epi16(_mm_max_epi16(_mm_add_epi16(x, adjust), Zero), MaxIndex);
+			}
+			_mm_store_si128(reinterpret_cast< __m128i * >(index), x);
+
+			//...and the step sizes they pick:
+#if !defined(__AVX2__)
+			for (uint32_t j = 0; j < run * Lanes; j += Lanes) {
+				int16_t *row = steps + j;
+				row[0] = tables.step[row[0]]; row[1] = tables.step[row[1]];
+				row[2] = tables.step[row[2]]; row[3] = tables.step[row[3]];
+				row[4] = tables.step[row[4]]; row[5] = tables.step[row[5]];
+				row[6] = tables.step[row[6]]; row[7] = tables.step[row[7]];
+			}
+#endif
+
+			//predictors: difference() as (step if bit 2) + (step/8 + step/2 if bit 1 + step/4 if bit 0), negated if bit 3:
+			__m128i p = _mm_load_si128(reinterpret_cast< __m128i const * >(predictor));
+			for (k = 0; k < run; ++k) {
+				__m128i n = _mm_load_si128(reinterpret_cast< __m128i const * >(nibbles + k * Lanes));
+				__m128i step = _mm_load_si128(reinterpret_cast< __m128i const * >(steps + k * Lanes));
+				__m128i big = _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(n, Four), Four), step);
+				__m128i small = _mm_srai_epi16(step, 3);
+				small = _mm_add_epi16(small, _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(n, Two), Two), _mm_srai_epi16(step, 1)));
+				small = _mm_add_epi16(small, _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(n, One), One), _mm_srai_epi16(step, 2)));
+				__m128i negative = _mm_cmpeq_epi16(_mm_and_si128(n, Eight), Eight);
+				big = _mm_sub_epi16(_mm_xor_si128(big, negative), negative);
+				small = _mm_sub_epi16(_mm_xor_si128(small, negative), negative);
+				p = _mm_adds_epi16(_mm_adds_epi16(p, big), small);
+				_mm_store_si128(reinterpret_cast< __m128i * >(decoded + k * Lanes), p);
+			}
+			_mm_store_si128(reinterpret_cast< __m128i * >(predictor), p);
+
+			//hand each stream back its frames (a lane pair is one interleaved stereo frame, so four
+			// frames of four streams are a 4x4 transpose of 32-bit values) and its state:
+			int16_t *out[Lanes / 2];
+			for (uint32_t s = 0; s < Lanes / 2; ++s) {
+				out[s] = (active[s] ? group[s].out + 2 * size_t(done[s]) : nullptr);
+			}
+			for (k = 0; k + 4 <= run; k += 4) {
+				__m128i const *in = reinterpret_cast< __m128i const * >(decoded + k * Lanes);
+				__m128i t0 = _mm_unpacklo_epi32(_mm_load_si128(in + 0), _mm_load_si128(in + 1));
+				__m128i t1 = _mm_unpacklo_epi32(_mm_load_si128(in + 2), _mm_load_si128(in + 3));
+				__m128i t2 = _mm_unpackhi_epi32(_mm_load_si128(in + 0), _mm_load_si128(in + 1));
+				__m128i t3 = _mm_unpackhi_epi32(_mm_load_si128(in + 2), _mm_load_si128(in + 3));
+				__m128i frames[Lanes / 2] = {
+					_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+					_mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)
+				};
+				for (uint32_t s = 0; s < Lanes / 2; ++s) {
+					if (out[s]) _mm_storeu_si128(reinterpret_cast< __m128i * >(out[s] + 2 * k), frames[s]);
+				}
+			}
+			for (; k < run; ++k) {
+				for (uint32_t s = 0; s < Lanes / 2; ++s) {
+					if (out[s]) std::memcpy(out[s] + 2 * k, decoded + k * Lanes + 2 * s, 2 * sizeof(int16_t));
+				}
+			}
+			for (uint32_t s = 0; s < Lanes / 2; ++s) {
+				if (!active[s]) continue;
+				for (uint32_t c = 0; c < 2; ++c) {
+					group[s].state[c].predictor = predictor[2 * s + c];
+					group[s].state[c].index = index[2 * s + c];
+				}
+				done[s] += run;
+			}
+		}
+	}
+}
+#else
+void Adpcm::decode(Stream const *streams, uint32_t count) {
+	decode_scalar(streams, count);
+}
+#endif
+
+char const *Adpcm::kernel_name() {
+#if defined(__AVX2__)
+	return "avx2";
+#elif defined(ADPCM_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
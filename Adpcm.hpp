@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// 'Adpcm' packs stereo 16-bit sound into IMA-ADPCM (4 bits per sample, so a
+// quarter of the memory) and unpacks it again while mixing.
+//
+// Data is a sequence of blocks of BlockFrames frames. Each block starts with
+// the decoder state for both channels (so playback can begin at any block),
+// followed by each channel's samples as nibbles, low nibble first:
+//   int16 left predictor, uint8 left step index, uint8 0,
+//   int16 right predictor, uint8 right step index, uint8 0,
+//   BlockFrames/2 bytes of left nibbles, BlockFrames/2 bytes of right nibbles
+// The last block is padded with zeros.
+//
+// Sound files (built by sounds/encode-adpcm.py, which writes the same format):
+//  "adp0": one AdpcmHeader
+//  "adb0": the blocks
+//
+// Each sample's prediction depends on the one before, so decoding is serial
+// within a channel; it is a handful of integer operations per sample, but one
+// sound alone leaves most of the core waiting on that chain. The batched
+// decode() runs the channels of four sounds side by side in SSE2 lanes.
+
+struct Adpcm {
+	enum : uint32_t { BlockFrames = 1024, BlockBytes = 2 * 4 + BlockFrames };
+
+	struct Header {
+		uint32_t rate; //frames per second
+		uint32_t frames;
+	};
+	static_assert(sizeof(Header) == 8, "Adpcm::Header should be packed.");
+
+	//decoder state for one channel:
+	struct State {
+		int32_t predictor = 0;
+		int32_t index = 0;
+	};
+
+	//encode 'frames' interleaved stereo frames (same output as sounds/encode-adpcm.py):
+	static std::vector< uint8_t > encode(int16_t const *samples, uint32_t frames);
+
+	//decode 'count' frames starting at frame 'first' to interleaved stereo 'out'.
+	//'state' carries the decoder from one call to the next; it is reset from
+	// the block header whenever a block starts, so playback begins on a block boundary:
+	static void decode(uint8_t const *blocks, uint32_t first, uint32_t count, State state[2], int16_t *out);
+
+	//one sound's part of a batched decode (the arguments of the decode() above):
+	struct Stream {
+		uint8_t const *blocks;
+		uint32_t first, count;
+		State *state; //[2]
+		int16_t *out;
+	};
+
+	//decode every stream in 'streams', with the same output and final states as calling
+	// decode() on each in turn (uses SSE2, or AVX2, where this build has it):
+	static void decode(Stream const *streams, uint32_t count);
+
+	//the same, one stream at a time (reference for the SIMD kernel and for benchmarks):
+	static void decode_scalar(Stream const *streams, uint32_t count);
+
+	//name of the kernel the batched decode() uses ("avx2", "sse2", or "scalar"):
+	static char const *kernel_name();
+};
@@ -0,0 +1,248 @@
+#include "Agents.hpp"
+#include "Simulation.hpp"
+#include "SpatialGrid.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AGENTS_SSE2
+#endif
+
+void Agents::resize(uint32_t count_, glm::vec2 location) {
+	uint32_t old_count = count;
+	count = count_;
+	uint32_t padded = (count + Width - 1) / Width * Width;
+
+	x.resize(padded, location.x);
+	y.resize(padded, location.y);
+	x_velocity.resize(padded, 0.0f);
+	y_velocity.resize(padded, 0.0f);
+	controls.resize(padded, 0);
+	next_pickup.resize(padded, 0);
+
+	//agents past the end (including padding) are reset so the kernels can run over full lanes:
+	for (uint32_t i = std::min(old_count, count); i < padded; ++i) {
+		x[i] = location.x;
+		y[i] = location.y;
+		x_velocity[i] = 0.0f;
+		y_velocity[i] = 0.0f;
+		controls[i] = 0;
+		next_pickup[i] = 0;
+	}
+}
+
+uint32_t Agents::pickup(Simulation const &level, SpatialGrid const &counter_grid) {
+	//every agent's adjacent counters in one batched query (same leeway as Simulation::update's pickup check):
+	counter_grid.query_adjacent(count, x.data(), y.data(), 0.5f, &hit_start, &hits);
+	uint32_t pickups = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint8_t wanted = level.level_progression[next_pickup[i]];
+		bool found = false;
+		for (uint32_t h = hit_start[i]; h < hit_start[i + 1]; ++h) {
+			if (hits[h] == wanted) found = true;
+		}
+		if (found) {
+			++pickups;
+			++next_pickup[i];
+			if (next_pickup[i] == level.progression_length) next_pickup[i] = 0;
+		}
+	}
+	return pickups;
+}
+
+char const *Agents::kernel_name() {
+#if defined(__AVX__)
+	return "avx";
+#elif defined(AGENTS_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+void Agents::update_scalar(float elapsed, glm::uvec2 board_size) {
+	const float max_velocity = Simulation::max_velocity;
+	const float acceleration = Simulation::acceleration;
+	const float deceleration = Simulation::deceleration;
+
+	for (uint32_t i = 0; i < count; ++i) {
+		bool go_left = (controls[i] & GoLeft) != 0;
+		bool go_right = (controls[i] & GoRight) != 0;
+		bool go_up = (controls[i] & GoUp) != 0;
+		bool go_down = (controls[i] & GoDown) != 0;
+		float &xv = x_velocity[i];
+		float &yv = y_velocity[i];
+
+		if (go_left) xv -= elapsed * acceleration;
+		if (go_up) yv += elapsed * acceleration;
+		if (go_right) xv += elapsed * acceleration;
+		if (go_down) yv -= elapsed * acceleration;
+
+		if (!go_left && !go_right && xv != 0.0f) {
+			int sign = xv < 0 ? -1 : 1;
+			xv -= sign * deceleration * elapsed;
+			if (sign > 0) xv = glm::clamp(xv, 0.0f, max_velocity);
+			else xv = glm::clamp(xv, -max_velocity, 0.0f);
+		}
+		if (!go_up && !go_down && yv != 0.0f) {
+			int sign = yv < 0 ? -1 : 1;
+			yv -= sign * deceleration * elapsed;
+			if (sign > 0) yv = glm::clamp(yv, 0.0f, max_velocity);
+			else yv = glm::clamp(yv, -max_velocity, 0.0f);
+		}
+
+		xv = glm::clamp(xv, -max_velocity, max_velocity);
+		yv = glm::clamp(yv, -max_velocity, max_velocity);
+
+		if (xv != 0.0f || yv != 0.0f) {
+			x[i] = glm::clamp(x[i] + xv * elapsed, 1.0f, (float) board_size.x - 2);
+			y[i] = glm::clamp(y[i] + yv * elapsed, 1.0f, (float) board_size.y - 2);
+			if (x[i] == 1.0f || x[i] == board_size.x - 2) xv = 0.0f;
+			if (y[i] == 1.0f || y[i] == board_size.y - 2) yv = 0.0f;
+		}
+	}
+}
+
+// The SIMD kernels compute the same thing as update_scalar without branches:
+//  - acceleration adds/subtracts (elapsed * acceleration) under a key mask, in the
+//    same order as the scalar code, so holding opposite keys rounds identically;
+//  - deceleration is copysign(max(|v| - elapsed * deceleration, 0), v), which is
+//    the scalar sign/clamp sequence (IEEE subtraction is symmetric in sign);
+//  - the location always moves by v * elapsed and is clamped (a zero velocity
+//    leaves it where the previous clamp put it), and velocity is zeroed on the
+//    board's inner edge.
+
+#if defined(__AVX__)
+
+void Agents::update(float elapsed, glm::uvec2 board_size) {
+	const __m256 accel = _mm256_set1_ps(elapsed * Simulation::acceleration);
+	const __m256 decel = _mm256_set1_ps(Simulation::deceleration * elapsed);
+	const __m256 max_v = _mm256_set1_ps(Simulation::max_velocity);
+	const __m256 min_v = _mm256_set1_ps(-Simulation::max_velocity);
+	const __m256 dt = _mm256_set1_ps(elapsed);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+	const __m256 lo = _mm256_set1_ps(1.0f);
+	const __m256 x_hi = _mm256_set1_ps((float) board_size.x - 2);
+	const __m256 y_hi = _mm256_set1_ps((float) board_size.y - 2);
+
+	auto key_mask = [](__m128i bits, int bit) {
+		__m128i b = _mm_set1_epi32(bit);
+		return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(bits, b), b));
+	};
+
+	auto axis = [&](__m256 &v, __m256 &p, __m256 held, __m256 hi) {
+		__m256 magnitude = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(sign_bit, v), decel), zero);
+		__m256 slowed = _mm256_or_ps(_mm256_min_ps(magnitude, max_v), _mm256_and_ps(sign_bit, v));
+		v = _mm256_or_ps(_mm256_and_ps(held, v), _mm256_andnot_ps(held, slowed));
+		v = _mm256_min_ps(_mm256_max_ps(v, min_v), max_v);
+
+		p = _mm256_add_ps(p, _mm256_mul_ps(v, dt));
+		p = _mm256_min_ps(_mm256_max_ps(p, lo), hi);
+		__m256 at_edge = _mm256_or_ps(_mm256_cmp_ps(p, lo, _CMP_EQ_OQ), _mm256_cmp_ps(p, hi, _CMP_EQ_OQ));
+		v = _mm256_andnot_ps(at_edge, v);
+	};
+
+	uint32_t padded = uint32_t(x.size());
+	for (uint32_t i = 0; i < padded; i += 8) {
+		//expand 8 control bytes to two sets of four 32-bit lanes:
+		__m128i bytes = _mm_loadl_epi64(reinterpret_cast< __m128i const * >(&controls[i]));
+		__m128i words = _mm_unpacklo_epi8(bytes, _mm_setzero_si128());
+		__m128i bits_lo = _mm_unpacklo_epi16(words, _mm_setzero_si128());
+		__m128i bits_hi = _mm_unpackhi_epi16(words, _mm_setzero_si128());
+		auto mask = [&](int bit) {
+			return _mm256_insertf128_ps(_mm256_castps128_ps256(key_mask(bits_lo, bit)), key_mask(bits_hi, bit), 1);
+		};
+
+		__m256 xv = _mm256_loadu_ps(&x_velocity[i]);
+		__m256 yv = _mm256_loadu_ps(&y_velocity[i]);
+		__m256 xp = _mm256_loadu_ps(&x[i]);
+		__m256 yp = _mm256_loadu_ps(&y[i]);
+
+		__m256 left = mask(GoLeft), right = mask(GoRight), up = mask(GoUp), down = mask(GoDown);
+		xv = _mm256_sub_ps(xv, _mm256_and_ps(left, accel));
+		yv = _mm256_add_ps(yv, _mm256_and_ps(up, accel));
+		xv = _mm256_add_ps(xv, _mm256_and_ps(right, accel));
+		yv = _mm256_sub_ps(yv, _mm256_and_ps(down, accel));
+
+		axis(xv, xp, _mm256_or_ps(left, right), x_hi);
+		axis(yv, yp, _mm256_or_ps(up, down), y_hi);
+
+		_mm256_storeu_ps(&x_velocity[i], xv);
+		_mm256_storeu_ps(&y_velocity[i], yv);
+		_mm256_storeu_ps(&x[i], xp);
+		_mm256_storeu_ps(&y[i], yp);
+	}
+}
+
+#elif defined(AGENTS_SSE2)
+
+void Agents::update(float elapsed, glm::uvec2 board_size) {
+	const __m128 accel = _mm_set1_ps(elapsed * Simulation::acceleration);
+	const __m128 decel = _mm_set1_ps(Simulation::deceleration * elapsed);
+	const __m128 max_v = _mm_set1_ps(Simulation::max_velocity);
+	const __m128 min_v = _mm_set1_ps(-Simulation::max_velocity);
+	const __m128 dt = _mm_set1_ps(elapsed);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 sign_bit = _mm_set1_ps(-0.0f);
+	const __m128 lo = _mm_set1_ps(1.0f);
+	const __m128 x_hi = _mm_set1_ps((float) board_size.x - 2);
+	const __m128 y_hi = _mm_set1_ps((float) board_size.y - 2);
+
+	auto axis = [&](__m128 &v, __m128 &p, __m128 held, __m128 hi) {
+		__m128 magnitude = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign_bit, v), decel), zero);
+		__m128 slowed = _mm_or_ps(_mm_min_ps(magnitude, max_v), _mm_and_ps(sign_bit, v));
+		v = _mm_or_ps(_mm_and_ps(held, v), _mm_andnot_ps(held, slowed));
+		v = _mm_min_ps(_mm_max_ps(v, min_v), max_v);
+
+		p = _mm_add_ps(p, _mm_mul_ps(v, dt));
+		p = _mm_min_ps(_mm_max_ps(p, lo), hi);
+		__m128 at_edge = _mm_or_ps(_mm_cmpeq_ps(p, lo), _mm_cmpeq_ps(p, hi));
+		v = _mm_andnot_ps(at_edge, v);
+	};
+
+	uint32_t padded = uint32_t(x.size());
+	for (uint32_t i = 0; i < padded; i += 4) {
+		//expand 4 control bytes to four 32-bit lanes:
+		int32_t packed;
+		std::memcpy(&packed, &controls[i], 4);
+		__m128i bits = _mm_cvtsi32_si128(packed);
+		bits = _mm_unpacklo_epi8(bits, _mm_setzero_si128());
+		bits = _mm_unpacklo_epi16(bits, _mm_setzero_si128());
+		auto mask = [&](int bit) {
+			__m128i b = _mm_set1_epi32(bit);
+			return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(bits, b), b));
+		};
+
+		__m128 xv = _mm_loadu_ps(&x_velocity[i]);
+		__m128 yv = _mm_loadu_ps(&y_velocity[i]);
+		__m128 xp = _mm_loadu_ps(&x[i]);
+		__m128 yp = _mm_loadu_ps(&y[i]);
+
+		__m128 left = mask(GoLeft), right = mask(GoRight), up = mask(GoUp), down = mask(GoDown);
+		xv = _mm_sub_ps(xv, _mm_and_ps(left, accel));
+		yv = _mm_add_ps(yv, _mm_and_ps(up, accel));
+		xv = _mm_add_ps(xv, _mm_and_ps(right, accel));
+		yv = _mm_sub_ps(yv, _mm_and_ps(down, accel));
+
+		axis(xv, xp, _mm_or_ps(left, right), x_hi);
+		axis(yv, yp, _mm_or_ps(up, down), y_hi);
+
+		_mm_storeu_ps(&x_velocity[i], xv);
+		_mm_storeu_ps(&y_velocity[i], yv);
+		_mm_storeu_ps(&x[i], xp);
+		_mm_storeu_ps(&y[i], yp);
+	}
+}
+
+#else
+
+void Agents::update(float elapsed, glm::uvec2 board_size) {
+	update_scalar(elapsed, board_size);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+struct Simulation;
+struct SpatialGrid;
+
+// 'Agents' moves many avatars at once using the same acceleration, deceleration
+// and board-clamping rules as Simulation::update, but with the state stored as
+// a structure of arrays (one array per field) so the step can run as a
+// branch-free SIMD kernel over 4 (SSE2) or 8 (AVX) agents at a time.
+//
+// Each agent also walks the level's progression on its own (pickup, below);
+// agents never generate levels, and their facing direction (render-only in
+// Simulation) isn't tracked.
+
+struct Agents {
+	//bits of controls[i]:
+	enum : uint8_t { GoLeft = 1, GoRight = 2, GoUp = 4, GoDown = 8 };
+
+	//lanes per SIMD step; arrays are padded to a multiple of this:
+	enum { Width = 8 };
+
+	//set the number of agents; new agents start at rest at 'location' with no keys held:
+	void resize(uint32_t count, glm::vec2 location);
+
+	//advance every agent by one step of 'elapsed' seconds on a board of 'board_size' tiles
+	// (uses the widest kernel this build was compiled for):
+	void update(float elapsed, glm::uvec2 board_size);
+
+	//the same step, one agent at a time, written like Simulation::update
+	// (reference for the SIMD kernels and for benchmarks; results compare equal):
+	void update_scalar(float elapsed, glm::uvec2 board_size);
+
+	//advance next_pickup for every agent adjacent to the counter its progression needs next,
+	// finding nearby counters through 'counter_grid' (built over level.counters' locations first,
+	// so their indices match level_progression, then any plain counters).
+	//Returns the number of pickups made:
+	uint32_t pickup(Simulation const &level, SpatialGrid const &counter_grid);
+
+	//name of the kernel update() uses ("avx", "sse2", or "scalar"):
+	static char const *kernel_name();
+
+	uint32_t count = 0;
+
+	//per-agent state, count entries each (plus padding, which is kept at rest):
+	std::vector< float > x, y; //location, tiles
+	std::vector< float > x_velocity, y_velocity; //tiles per second
+	std::vector< uint8_t > controls; //Go* bits
+	std::vector< uint8_t > next_pickup; //index into level_progression
+
+	//pickup's working storage for the batched counter query (kept to avoid reallocating every tick):
+	std::vector< uint32_t > hit_start, hits;
+};
@@ -0,0 +1,131 @@
+#include "AudioStream.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+AudioStream::AudioStream(std::string const &filename_, bool loop_, uint32_t ring_frames)
+	: filename(filename_), loop(loop_), ring(2 * ring_frames), file(filename_, std::ios::binary) {
+	if (!file) {
+		throw std::runtime_error("Failed to open audio stream '" + filename + "'.");
+	}
+
+	//skip to the "pcm0" chunk (chunk headers are as in read_chunk.hpp):
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+	while (true) {
+		ChunkHeader header;
+		if (!file.read(reinterpret_cast< char * >(&header), sizeof(header))) {
+			throw std::runtime_error("No 'pcm0' chunk in audio stream '" + filename + "'.");
+		}
+		if (std::memcmp(header.magic, "pcm0", 4) == 0) {
+			data_frames = header.size / (2 * sizeof(int16_t));
+			break;
+		}
+		file.seekg(header.size, std::ios::cur);
+	}
+	data_begin = file.tellg();
+
+	//fill the ring before playback can start, so the first buffers don't underrun:
+	uint32_t filled;
+	do {
+		filled = ring.size();
+		if (!read_piece()) break;
+	} while (ring.size() != filled);
+
+	reader = std::thread(&AudioStream::read_ahead, this);
+}
+
+AudioStream::~AudioStream() {
+	quit.store(true, std::memory_order_relaxed);
+	reader.join();
+}
+
+uint32_t AudioStream::read(int16_t *out, uint32_t frames) {
+	uint32_t state = restart_state.load(std::memory_order_acquire);
+	if (state != Idle) {
+		//drop what was read before the restart; once the reader has rewound, nothing older can arrive:
+		int16_t scrap[256];
+		while (ring.pop(scrap, 256)) { }
+		if (state == Requested) return 0;
+		restart_state.store(Idle, std::memory_order_release);
+	}
+	//(the reader only ever pushes whole frames)
+	uint32_t got = ring.pop(out, 2 * frames) / 2;
+	if (got) {
+		started = true;
+		rewinding = false;
+	}
+	return got;
+}
+
+bool AudioStream::finished() const {
+	return restart_state.load(std::memory_order_acquire) == Idle
+		&& end_of_file.load(std::memory_order_acquire) && ring.size() == 0;
+}
+
+void AudioStream::restart() {
+	if (!started) return;
+	started = false;
+	rewinding = true;
+	restart_state.store(Requested, std::memory_order_release);
+}
+
+bool AudioStream::restarting() const {
+	return rewinding;
+}
+
+bool AudioStream::read_piece() {
+	//reads go to the file in pieces of a quarter of the ring, once that much room is free:
+	uint32_t piece = (ring.mask + 1) / 4;
+	if ((ring.mask + 1) - ring.size() < piece) return true;
+	if (next_frame == data_frames) {
+		if (!loop || data_frames == 0) return false;
+		file.clear();
+		file.seekg(data_begin);
+		next_frame = 0;
+	}
+	uint32_t frames = std::min(piece / 2, data_frames - next_frame);
+	buffer.resize(2 * frames);
+	if (!file.read(reinterpret_cast< char * >(buffer.data()), frames * 2 * sizeof(int16_t))) {
+		//(truncated file: play what there was)
+		frames = uint32_t(file.gcount() / (2 * sizeof(int16_t)));
+		data_frames = next_frame + frames;
+	}
+	next_frame += frames;
+	uint32_t pushed = ring.push(buffer.data(), 2 * frames);
+	(void)pushed;
+	assert(pushed == 2 * frames);
+	return true;
+}
+
+void AudioStream::read_ahead() {
+	//(the thread keeps running past the end of the file, in case the stream is restarted)
+	while (!quit.load(std::memory_order_relaxed)) {
+		uint32_t state = restart_state.load(std::memory_order_acquire);
+		if (state == Requested) {
+			file.clear();
+			file.seekg(data_begin);
+			next_frame = 0;
+			end_of_file.store(false, std::memory_order_relaxed);
+			//(release: once the audio thread sees Rewound, everything pushed before is in the ring for it to drop)
+			restart_state.compare_exchange_strong(state, Rewound, std::memory_order_acq_rel);
+		}
+		if (state != Idle) {
+			//(nothing new goes in until the audio thread has dropped the old data)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		uint32_t before = ring.size();
+		if (!read_piece()) end_of_file.store(true, std::memory_order_release);
+		if (ring.size() == before) {
+			//(a quarter of the ring lasts tens of milliseconds, so polling costs nothing)
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+	}
+}
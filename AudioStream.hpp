@@ -0,0 +1,77 @@
+#pragma once
+
+#include "SPSCQueue.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+// 'AudioStream' plays a long sound (music, ambience) without loading it: a
+// background thread reads the file a little at a time into a fixed-size
+// lock-free ring, and the audio thread drains the ring as it mixes. Memory use
+// is the ring, whatever the length of the track.
+//
+// Files hold uncompressed interleaved stereo 16-bit samples at the device's
+// rate in a "pcm0" chunk (chunk headers as in read_chunk.hpp; other chunks
+// before it are skipped). To make one, write the samples out with
+// write_chunk("pcm0", samples, &file), as audio-stress does.
+//
+// Add a stream to a Mixer with add_stream and play it like any other sound;
+// a stream has one read position, so it should only be playing once at a time.
+// Playing it again starts it over: the audio thread asks the reader to rewind
+// (restart), and drops what was already in the ring once the reader has, so
+// a replay begins a buffer or two after play() instead of at once.
+
+struct AudioStream {
+	//opens 'filename' and starts the reader thread; throws if the file can't be read.
+	//'ring_frames' is rounded up to a power of two:
+	AudioStream(std::string const &filename, bool loop, uint32_t ring_frames = 16384);
+	~AudioStream(); //stops the reader thread
+
+	//------- audio thread -------
+
+	//copy up to 'frames' frames into 'out'; returns how many were ready:
+	uint32_t read(int16_t *out, uint32_t frames);
+
+	//true once the reader has reached the end of the file (never, if looping) and everything was read:
+	bool finished() const;
+
+	//go back to the start of the file (no effect if nothing has been read since the last start):
+	void restart();
+
+	//true from restart() until data from the start of the file has been read:
+	bool restarting() const;
+
+	//------- state -------
+
+	std::string filename;
+	bool loop = false;
+
+	SPSCQueue< int16_t > ring;
+
+	//reader thread only:
+	std::ifstream file;
+	std::streamoff data_begin = 0; //byte offset of the first sample
+	uint32_t data_frames = 0;
+	uint32_t next_frame = 0; //next frame to read from the file
+
+	std::vector< int16_t > buffer; //file data on its way to the ring
+
+	//restart handshake: the audio thread asks (Requested), the reader rewinds (Rewound),
+	// and the audio thread drops the ring's older data and carries on (Idle):
+	enum : uint32_t { Idle = 0, Requested = 1, Rewound = 2 };
+	std::atomic< uint32_t > restart_state{Idle};
+
+	//audio thread only:
+	bool started = false; //anything read since the last (re)start
+	bool rewinding = false; //restarted, and nothing read since
+
+	std::atomic< bool > end_of_file{false};
+	std::atomic< bool > quit{false};
+	std::thread reader;
+	void read_ahead(); //the reader thread's loop
+	bool read_piece(); //read into the ring if there's room; returns false at the end of a non-looping file
+};
@@ -0,0 +1,95 @@
+#include "Bots.hpp"
+#include "Agents.hpp"
+#include "SpatialGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//tiles that can't be reached (counters, or anything walled off) keep this distance:
+static const uint16_t Unreachable = 0xffff;
+
+void BotFields::update(Simulation const &sim) {
+	if (level == sim.level && size == sim.board_size) return;
+	level = sim.level;
+	size = sim.board_size;
+
+	uint32_t tiles = size.x * size.y;
+	fields.assign(Simulation::CounterCount * tiles, Unreachable);
+	queue.resize(tiles);
+
+	//the avatar stands on the board's inside tiles:
+	auto walkable = [&](int32_t x, int32_t y) {
+		return x >= 1 && y >= 1 && x <= int32_t(size.x) - 2 && y <= int32_t(size.y) - 2;
+	};
+
+	for (uint8_t c = 0; c < Simulation::CounterCount; ++c) {
+		uint16_t *field = &fields[c * tiles];
+		glm::vec2 counter = glm::vec2(sim.counters[c].location);
+
+		//seed with every tile that picks up the counter (same test as Simulation::update):
+		uint32_t head = 0, tail = 0;
+		for (uint32_t y = 0; y < size.y; ++y) {
+			for (uint32_t x = 0; x < size.x; ++x) {
+				if (walkable(x, y) && adjacent(counter, glm::vec2(x, y), 0.5f)) {
+					field[y * size.x + x] = 0;
+					queue[tail++] = y * size.x + x;
+				}
+			}
+		}
+
+		//breadth-first over 4-connected walkable tiles:
+		while (head < tail) {
+			uint32_t at = queue[head++];
+			int32_t x = int32_t(at % size.x), y = int32_t(at / size.x);
+			uint16_t next = field[at] + 1;
+			const int32_t steps[4][2] = {{-1,0}, {1,0}, {0,-1}, {0,1}};
+			for (auto const &s : steps) {
+				int32_t nx = x + s[0], ny = y + s[1];
+				if (!walkable(nx, ny)) continue;
+				uint32_t n = uint32_t(ny) * size.x + uint32_t(nx);
+				if (field[n] != Unreachable) continue;
+				field[n] = next;
+				queue[tail++] = n;
+			}
+		}
+	}
+}
+
+uint8_t BotFields::steer(uint8_t counter, glm::vec2 location, glm::vec2 velocity) const {
+	//where the avatar ends up if it lets go now (v^2 / 2a along each axis):
+	glm::vec2 stop = location + glm::vec2(
+		velocity.x * std::abs(velocity.x),
+		velocity.y * std::abs(velocity.y)
+	) / (2.0f * Simulation::deceleration);
+	glm::ivec2 tile = glm::ivec2(
+		int32_t(std::floor(glm::clamp(stop.x, 1.0f, float(size.x) - 2.0f) + 0.5f)),
+		int32_t(std::floor(glm::clamp(stop.y, 1.0f, float(size.y) - 2.0f) + 0.5f))
+	);
+
+	uint16_t here = distance(counter, tile);
+	if (here == 0) return 0; //coasting will do
+
+	uint8_t bits = 0;
+	if (tile.x + 1 <= int32_t(size.x) - 2 && distance(counter, tile + glm::ivec2(1, 0)) < here) bits |= Agents::GoRight;
+	else if (tile.x - 1 >= 1 && distance(counter, tile - glm::ivec2(1, 0)) < here) bits |= Agents::GoLeft;
+	if (tile.y + 1 <= int32_t(size.y) - 2 && distance(counter, tile + glm::ivec2(0, 1)) < here) bits |= Agents::GoUp;
+	else if (tile.y - 1 >= 1 && distance(counter, tile - glm::ivec2(0, 1)) < here) bits |= Agents::GoDown;
+	return bits;
+}
+
+void BotFields::drive(Simulation *sim) {
+	update(*sim);
+	uint8_t bits = steer(sim->level_progression[sim->next_pickup],
+		glm::vec2(sim->avatar_location), glm::vec2(sim->x_velocity, sim->y_velocity));
+	sim->controls.go_left = (bits & Agents::GoLeft) != 0;
+	sim->controls.go_right = (bits & Agents::GoRight) != 0;
+	sim->controls.go_up = (bits & Agents::GoUp) != 0;
+	sim->controls.go_down = (bits & Agents::GoDown) != 0;
+}
+
+void BotFields::drive(Agents *agents, Simulation const &level_) const {
+	for (uint32_t i = 0; i < agents->count; ++i) {
+		agents->controls[i] = steer(level_.level_progression[agents->next_pickup[i]],
+			glm::vec2(agents->x[i], agents->y[i]), glm::vec2(agents->x_velocity[i], agents->y_velocity[i]));
+	}
+}
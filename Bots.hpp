@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Simulation.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+struct Agents;
+
+// Bots play the game by setting the same controls a player would.
+//
+// 'BotFields' holds one breadth-first distance field per key counter: for
+// every tile the avatar can stand on, the number of steps to the nearest tile
+// from which that counter gets picked up. Fields only depend on the counter
+// layout, so they are rebuilt when the level changes and then shared by any
+// number of bots playing that layout.
+//
+// Steering looks up the tile where the avatar would coast to a stop and moves
+// downhill in the field of the counter it needs next, so a bot costs a few
+// table lookups per step.
+
+struct BotFields {
+	//rebuild the fields if 'sim' is on a different level than they were built for:
+	void update(Simulation const &sim);
+
+	//steps from 'tile' to a pickup spot for 'counter' (0 = picks up from here):
+	uint16_t distance(uint8_t counter, glm::ivec2 tile) const {
+		return fields[counter * size.x * size.y + tile.y * size.x + tile.x];
+	}
+
+	//Agents-style control bits (Agents::GoLeft, ...) that move an avatar at 'location'
+	// with the given velocity toward 'counter':
+	uint8_t steer(uint8_t counter, glm::vec2 location, glm::vec2 velocity) const;
+
+	//set a Simulation's controls toward its next pickup (rebuilding fields as needed):
+	void drive(Simulation *sim);
+	//set every agent's controls toward its own next pickup on 'level' (fields must be up to date for it):
+	void drive(Agents *agents, Simulation const &level) const;
+
+	uint32_t level = -1U; //sim.level the fields were built for
+	glm::uvec2 size = glm::uvec2(0, 0);
+	std::vector< uint16_t > fields; //CounterCount fields of size.x * size.y tiles
+	std::vector< uint32_t > queue; //BFS working storage
+};
@@ -0,0 +1,108 @@
+#include "CounterPlacement.hpp"
+#include "SpatialGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t CounterPlacement::edge_cells(glm::uvec2 board_size) {
+	if (board_size.x < 3 || board_size.y < 3) return 0;
+	return 2 * (board_size.x - 2) + 2 * (board_size.y - 2);
+}
+
+glm::uvec2 CounterPlacement::edge_cell(glm::uvec2 board_size, uint32_t i) {
+	uint32_t w = board_size.x - 2, h = board_size.y - 2;
+	if (i < w) return glm::uvec2(1 + i, 0); //bottom, left to right
+	i -= w;
+	if (i < h) return glm::uvec2(board_size.x - 1, 1 + i); //right, bottom to top
+	i -= h;
+	if (i < w) return glm::uvec2(w - i, board_size.y - 1); //top, right to left
+	i -= w;
+	return glm::uvec2(0, h - i); //left, top to bottom
+}
+
+uint32_t CounterPlacement::place(glm::uvec2 board_size, float leeway, uint32_t max_count,
+	glm::vec2 const *avoid, uint32_t avoid_count, float avoid_leeway,
+	PCG32 &rng, std::vector< glm::uvec2 > *out) {
+
+	uint32_t cells = edge_cells(board_size);
+	if (cells == 0 || max_count == 0) return 0;
+
+	//integer cells are adjacent with 'leeway' when within 1 + leeway on both axes,
+	// so counters need at least this much space on some axis:
+	spacing = uint32_t(std::floor(1.0f + leeway)) + 1;
+
+	//grid cells are 'spacing' on a side, so each can hold at most one counter,
+	// and anything too close to a cell is in one of the 3x3 grid cells around it:
+	grid_size = (board_size + glm::uvec2(spacing - 1)) / spacing;
+	grid.assign(grid_size.x * grid_size.y, 0);
+	placed.clear();
+	placed_cells.clear();
+	active.clear();
+
+	auto fits = [&](glm::uvec2 cell) {
+		glm::vec2 at = glm::vec2(cell);
+		for (uint32_t a = 0; a < avoid_count; ++a) {
+			if (adjacent(at, avoid[a], avoid_leeway)) return false;
+		}
+		glm::uvec2 g = cell / spacing;
+		uint32_t x0 = g.x > 0 ? g.x - 1 : 0, x1 = std::min(g.x + 1, grid_size.x - 1);
+		uint32_t y0 = g.y > 0 ? g.y - 1 : 0, y1 = std::min(g.y + 1, grid_size.y - 1);
+		for (uint32_t gy = y0; gy <= y1; ++gy) {
+			for (uint32_t gx = x0; gx <= x1; ++gx) {
+				uint32_t slot = grid[gy * grid_size.x + gx];
+				if (slot && adjacent(glm::vec2(placed_cells[slot - 1]), at, leeway)) return false;
+			}
+		}
+		return true;
+	};
+
+	auto add = [&](uint32_t edge_index, glm::uvec2 cell) {
+		glm::uvec2 g = cell / spacing;
+		placed.emplace_back(edge_index);
+		placed_cells.emplace_back(cell);
+		grid[g.y * grid_size.x + g.x] = uint32_t(placed.size());
+		active.emplace_back(uint32_t(placed.size()) - 1);
+	};
+
+	//first counter: a random edge cell that fits (scanning onward from it if it doesn't):
+	{
+		uint32_t start = rng.below(cells);
+		for (uint32_t step = 0; step < cells; ++step) {
+			uint32_t i = (start + step) % cells;
+			glm::uvec2 cell = edge_cell(board_size, i);
+			if (fits(cell)) {
+				add(i, cell);
+				break;
+			}
+		}
+	}
+
+	//grow outward from active counters, trying spots one to two spacings away along the edge:
+	while (!active.empty() && placed.size() < max_count) {
+		uint32_t a = rng.below(uint32_t(active.size()));
+		uint32_t from = placed[active[a]];
+		bool found = false;
+		for (uint32_t t = 0; t < tries && !found; ++t) {
+			uint32_t offset = spacing + rng.below(spacing);
+			uint32_t i = (rng.next() & 1) ? (from + offset) % cells : (from + cells - offset % cells) % cells;
+			glm::uvec2 cell = edge_cell(board_size, i);
+			if (fits(cell)) {
+				add(i, cell);
+				found = true;
+			}
+		}
+		if (!found) {
+			active[a] = active.back();
+			active.pop_back();
+		}
+	}
+
+	//fill whatever gaps the random tries missed:
+	for (uint32_t i = 0; i < cells && placed.size() < max_count; ++i) {
+		glm::uvec2 cell = edge_cell(board_size, i);
+		if (fits(cell)) add(i, cell);
+	}
+
+	out->insert(out->end(), placed_cells.begin(), placed_cells.end());
+	return uint32_t(placed.size());
+}
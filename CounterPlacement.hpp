@@ -0,0 +1,45 @@
+#pragma once
+
+#include "PCG32.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// 'CounterPlacement' scatters counters over the board's edge cells (the ring
+// of tiles just inside the corners) with Bridson-style Poisson-disk sampling:
+// new counters are tried at random distances of one to two separations along
+// the edge from existing ones, and a background grid with one sample per cell
+// answers "is anything too close" in constant time. A final sweep fills any
+// gaps the random tries left, so the result is maximal: no edge cell is left
+// that could take another counter.
+//
+// Separation uses the same rule as the game: no two counters are
+// adjacent(A, B, leeway), and no counter is adjacent(A, avoid, avoid_leeway).
+//
+// Storage is kept between calls, so one placer can generate many levels.
+
+struct CounterPlacement {
+	//place up to 'max_count' counters on the edge of a 'board_size' board, appending their cells to 'out'
+	// (in placement order). Returns the number placed:
+	uint32_t place(glm::uvec2 board_size, float leeway, uint32_t max_count,
+		glm::vec2 const *avoid, uint32_t avoid_count, float avoid_leeway,
+		PCG32 &rng, std::vector< glm::uvec2 > *out);
+
+	//number of edge cells on a board (corners excluded):
+	static uint32_t edge_cells(glm::uvec2 board_size);
+	//the i'th edge cell, walking around the board so consecutive cells are neighbors:
+	static glm::uvec2 edge_cell(glm::uvec2 board_size, uint32_t i);
+
+	//tries per active sample before it is retired (Bridson's 'k'; the edge is one-dimensional, so a few are enough):
+	uint32_t tries = 8;
+
+	//------- working storage -------
+	uint32_t spacing = 0; //grid cell size in tiles (= minimum distance between counters on an axis)
+	glm::uvec2 grid_size = glm::uvec2(0, 0);
+	std::vector< uint32_t > grid; //1 + index into 'placed' of the counter in each grid cell, or 0
+	std::vector< uint32_t > placed; //edge index of each placed counter
+	std::vector< glm::uvec2 > placed_cells; //cell of each placed counter
+	std::vector< uint32_t > active; //indices into 'placed' that may still have room nearby
+};
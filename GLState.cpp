@@ -0,0 +1,175 @@
+#include "GLState.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstring>
+
+void GLState::use_program(GLuint program_) {
+	if (program_known && program == program_) {
+		++frame_stats.elided;
+		return;
+	}
+	glUseProgram(program_);
+	program_known = true;
+	program = program_;
+	++frame_stats.submitted;
+}
+
+void GLState::bind_vertex_array(GLuint vao) {
+	if (vertex_array_known && vertex_array == vao) {
+		++frame_stats.elided;
+		return;
+	}
+	glBindVertexArray(vao);
+	vertex_array_known = true;
+	vertex_array = vao;
+	++frame_stats.submitted;
+}
+
+void GLState::bind_buffer(GLenum target, GLuint buffer) {
+	if (target != GL_ELEMENT_ARRAY_BUFFER) {
+		auto f = buffers.find(target);
+		if (f != buffers.end() && f->second == buffer) {
+			++frame_stats.elided;
+			return;
+		}
+		buffers[target] = buffer;
+	}
+	glBindBuffer(target, buffer);
+	++frame_stats.submitted;
+}
+
+void GLState::bind_framebuffer(GLuint framebuffer_) {
+	if (framebuffer_known && framebuffer == framebuffer_) {
+		++frame_stats.elided;
+		return;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+	framebuffer_known = true;
+	framebuffer = framebuffer_;
+	++frame_stats.submitted;
+}
+
+void GLState::bind_texture(GLuint unit, GLenum target, GLuint texture) {
+	uint64_t key = (uint64_t(unit) << 32) | uint64_t(target);
+	auto f = textures.find(key);
+	if (f != textures.end() && f->second == texture) {
+		++frame_stats.elided;
+		return;
+	}
+	if (!(active_texture_known && active_texture == unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		active_texture_known = true;
+		active_texture = unit;
+		++frame_stats.submitted;
+	}
+	glBindTexture(target, texture);
+	textures[key] = texture;
+	++frame_stats.submitted;
+}
+
+void GLState::enable(GLenum cap) {
+	auto f = caps.find(cap);
+	if (f != caps.end() && f->second) {
+		++frame_stats.elided;
+		return;
+	}
+	glEnable(cap);
+	caps[cap] = true;
+	++frame_stats.submitted;
+}
+
+void GLState::disable(GLenum cap) {
+	auto f = caps.find(cap);
+	if (f != caps.end() && !f->second) {
+		++frame_stats.elided;
+		return;
+	}
+	glDisable(cap);
+	caps[cap] = false;
+	++frame_stats.submitted;
+}
+
+void GLState::blend_func(GLenum sfactor, GLenum dfactor) {
+	if (blend_known && blend_sfactor == sfactor && blend_dfactor == dfactor) {
+		++frame_stats.elided;
+		return;
+	}
+	glBlendFunc(sfactor, dfactor);
+	blend_known = true;
+	blend_sfactor = sfactor;
+	blend_dfactor = dfactor;
+	++frame_stats.submitted;
+}
+
+void GLState::clear_color(glm::vec4 const &color) {
+	if (clear_color_known && clear_color_value == color) {
+		++frame_stats.elided;
+		return;
+	}
+	glClearColor(color.x, color.y, color.z, color.w);
+	clear_color_known = true;
+	clear_color_value = color;
+	++frame_stats.submitted;
+}
+
+bool GLState::uniform_changed(GLuint location, float const *data, uint32_t floats) {
+	//without a known program there is nothing to key the shadow value on:
+	if (!program_known) {
+		++frame_stats.submitted;
+		return true;
+	}
+
+	uint64_t key = (uint64_t(program) << 32) | uint64_t(location);
+	UniformShadow &shadow = uniforms[key];
+	if (shadow.floats == floats && std::memcmp(shadow.data, data, floats * sizeof(float)) == 0) {
+		++frame_stats.elided;
+		return false;
+	}
+	shadow.floats = floats;
+	std::memcpy(shadow.data, data, floats * sizeof(float));
+	++frame_stats.submitted;
+	return true;
+}
+
+void GLState::uniform(GLuint location, glm::vec3 const &value) {
+	if (uniform_changed(location, glm::value_ptr(value), 3)) {
+		glUniform3fv(location, 1, glm::value_ptr(value));
+	}
+}
+
+void GLState::uniform(GLuint location, glm::mat3 const &value) {
+	if (uniform_changed(location, glm::value_ptr(value), 9)) {
+		glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+void GLState::uniform(GLuint location, glm::mat4x3 const &value) {
+	if (uniform_changed(location, glm::value_ptr(value), 12)) {
+		glUniformMatrix4x3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+void GLState::uniform(GLuint location, glm::mat4 const &value) {
+	if (uniform_changed(location, glm::value_ptr(value), 16)) {
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+void GLState::invalidate() {
+	program_known = false;
+	vertex_array_known = false;
+	buffers.clear();
+	framebuffer_known = false;
+	active_texture_known = false;
+	textures.clear();
+	caps.clear();
+	blend_known = false;
+	clear_color_known = false;
+	uniforms.clear();
+}
+
+void GLState::begin_frame() {
+	last_frame_stats = frame_stats;
+	frame_stats = Stats();
+}
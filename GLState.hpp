@@ -0,0 +1,89 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <cstdint>
+
+// The 'GLState' struct is a thin cache in front of the OpenGL state that the
+// game touches every frame (bound program/VAO/buffers, enable bits, blend
+// function, clear color and uniform values). Calls that would not change the
+// current state are dropped instead of being sent to the driver.
+//
+// The cache only knows about changes made through it; code that changes the
+// same state directly should call invalidate() afterward.
+
+struct GLState {
+	//------- bindings -------
+	void use_program(GLuint program);
+	void bind_vertex_array(GLuint vao);
+	//NOTE: GL_ELEMENT_ARRAY_BUFFER is part of the VAO state, so it is passed through uncached:
+	void bind_buffer(GLenum target, GLuint buffer);
+	void bind_framebuffer(GLuint framebuffer); //binds GL_FRAMEBUFFER (draw + read)
+	void bind_texture(GLuint unit, GLenum target, GLuint texture); //also selects the texture unit
+
+	//------- fixed-function state -------
+	void enable(GLenum cap);
+	void disable(GLenum cap);
+	void blend_func(GLenum sfactor, GLenum dfactor);
+	void clear_color(glm::vec4 const &color);
+
+	//------- uniforms of the currently bound program -------
+	// (values are shadowed per program+location, so they survive switching programs)
+	void uniform(GLuint location, glm::vec3 const &value);
+	void uniform(GLuint location, glm::mat3 const &value);
+	void uniform(GLuint location, glm::mat4x3 const &value);
+	void uniform(GLuint location, glm::mat4 const &value);
+
+	//forget all cached state (the next call of every kind is submitted):
+	void invalidate();
+
+	//------- statistics -------
+	struct Stats {
+		uint32_t submitted = 0; //calls passed on to OpenGL
+		uint32_t elided = 0; //calls dropped as redundant
+	};
+	Stats frame_stats; //counts for the frame in progress
+	Stats last_frame_stats; //counts for the previous frame
+
+	//begin_frame should be called once per main loop pass; it moves frame_stats into last_frame_stats:
+	void begin_frame();
+
+	//------- cached values (valid only if the matching 'known' flag is set) -------
+	bool program_known = false;
+	GLuint program = 0;
+
+	bool vertex_array_known = false;
+	GLuint vertex_array = 0;
+
+	std::unordered_map< GLenum, GLuint > buffers;
+
+	bool framebuffer_known = false;
+	GLuint framebuffer = 0;
+
+	bool active_texture_known = false;
+	GLuint active_texture = 0;
+	//keyed by (unit << 32) | target:
+	std::unordered_map< uint64_t, GLuint > textures;
+
+	std::unordered_map< GLenum, bool > caps;
+
+	bool blend_known = false;
+	GLenum blend_sfactor = GL_ONE;
+	GLenum blend_dfactor = GL_ZERO;
+
+	bool clear_color_known = false;
+	glm::vec4 clear_color_value = glm::vec4(0.0f);
+
+	struct UniformShadow {
+		uint32_t floats = 0;
+		float data[16];
+	};
+	//keyed by (program << 32) | location:
+	std::unordered_map< uint64_t, UniformShadow > uniforms;
+
+	//returns true (and updates the shadow) if the value differs from the cached one:
+	bool uniform_changed(GLuint location, float const *data, uint32_t floats);
+};
@@ -2,33 +2,46 @@
 
 #include "gl_errors.hpp" //helper for dumping OpenGL error messages
 #include "read_chunk.hpp" //helper for reading a vector of structures from a file
+#include "write_chunk.hpp" //helper for writing a vector of structures to a file
 #include "data_path.hpp" //helper to get paths relative to executable
+#include "Resampler.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <SDL_audio.h>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
-#include <set>
 #include <map>
+#include <cmath>
 #include <cstddef>
-#include <random>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
 
+//audio device buffer, in frames (a new note is heard within one buffer):
 #define BUFFER_SIZE 512
-#define AUDIO_VOLUME 10
+//note volume, as a fraction of full scale (what SDL_MixAudio's volume of 10 out of 128 gave):
+#define AUDIO_VOLUME (10.0f / 128.0f)
 
 //helper defined later; throws if shader compilation fails:
 static glm::mat4 location_v3m4(glm::vec3 v, glm::quat r);
 static GLuint compile_shader(GLenum type, std::string const &source);
-static bool adjacent(glm::vec3 locationA, glm::vec3 locationB, float leeway);
+static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader);
 static void audio_callback(void *userdata, Uint8 *stream, int len);
+static std::vector< uint8_t > load_sound(std::string const &filename, SDL_AudioSpec const &device_spec, uint32_t *frames);
 
-uint8_t *current_audio_pos;
-uint32_t current_audio_len;
+//vertex format used by meshes_vbo (and by the profiler overlay bars):
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+};
+static_assert(sizeof(Vertex) == 28, "Vertex should be packed.");
 
-Game::Game() {
+Game::Game(uint64_t seed) : sim(seed), level_prefetch(jobs) {
 	{ //create an opengl program to perform sun/sky (well, directional+hemispherical) lighting:
 		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
 			"#version 330\n"
@@ -77,27 +90,7 @@ Game::Game() {
 			"}\n"
 		);
 
-		simple_shading.program = glCreateProgram();
-		glAttachShader(simple_shading.program, vertex_shader);
-		glAttachShader(simple_shading.program, fragment_shader);
-		//shaders are reference counted so this makes sure they are freed after program is deleted:
-		glDeleteShader(vertex_shader);
-		glDeleteShader(fragment_shader);
-
-		//link the shader program and throw errors if linking fails:
-		glLinkProgram(simple_shading.program);
-		GLint link_status = GL_FALSE;
-		glGetProgramiv(simple_shading.program, GL_LINK_STATUS, &link_status);
-		if (link_status != GL_TRUE) {
-			std::cerr << "Failed to link shader program." << std::endl;
-			GLint info_log_length = 0;
-			glGetProgramiv(simple_shading.program, GL_INFO_LOG_LENGTH, &info_log_length);
-			std::vector< GLchar > info_log(info_log_length, 0);
-			GLsizei length = 0;
-			glGetProgramInfoLog(simple_shading.program, GLsizei(info_log.size()), &length, &info_log[0]);
-			std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
-			throw std::runtime_error("failed to link program");
-		}
+		simple_shading.program = link_program(vertex_shader, fragment_shader);
 	}
 
 	{ //read back uniform and attribute locations from the shader program:
@@ -116,13 +109,6 @@ Game::Game() {
 		simple_shading.Color_vec4 = glGetAttribLocation(simple_shading.program, "Color");
 	}
 
-	struct Vertex {
-		glm::vec3 Position;
-		glm::vec3 Normal;
-		glm::u8vec4 Color;
-	};
-	static_assert(sizeof(Vertex) == 28, "Vertex should be packed.");
-
 	{ //load mesh data from a binary blob:
 		std::ifstream blob(data_path("pbj_meshes.blob"), std::ios::binary);
 		//The blob will be made up of three chunks:
@@ -231,74 +217,162 @@ Game::Game() {
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
+	{ //create a program that copies the cached board layer (color and depth) to the screen:
+		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
+			"#version 330\n"
+			"void main() {\n" //full-screen triangle from vertex ids 0,1,2
+			"	gl_Position = vec4(4 * (gl_VertexID & 1) - 1, 2 * (gl_VertexID & 2) - 1, 0.0, 1.0);\n"
+			"}\n"
+		);
+
+		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
+			"#version 330\n"
+			"uniform sampler2D color_tex;\n"
+			"uniform sampler2D depth_tex;\n"
+			"out vec4 fragColor;\n"
+			"void main() {\n"
+			"	ivec2 px = ivec2(gl_FragCoord.xy);\n"
+			"	fragColor = texelFetch(color_tex, px, 0);\n"
+			"	gl_FragDepth = texelFetch(depth_tex, px, 0).r;\n"
+			"}\n"
+		);
+
+		board_composite.program = link_program(vertex_shader, fragment_shader);
+
+		//samplers read from fixed texture units:
+		glUseProgram(board_composite.program);
+		glUniform1i(glGetUniformLocation(board_composite.program, "color_tex"), 0);
+		glUniform1i(glGetUniformLocation(board_composite.program, "depth_tex"), 1);
+		glUseProgram(0);
+
+		//core profile needs some vertex array bound to draw, even without attributes:
+		glGenVertexArrays(1, &board_composite.empty_vao);
+
+		glGenFramebuffers(1, &board_composite.framebuffer);
+		glGenTextures(1, &board_composite.color_tex);
+		glGenTextures(1, &board_composite.depth_tex);
+		//(texture storage is allocated in draw(), once the drawable size is known)
+	}
+
+	{ //create a (streamed) vertex buffer + vertex array object for the profiler overlay bars:
+		glGenBuffers(1, &profiler_bars_vbo);
+		glGenVertexArrays(1, &profiler_bars_for_simple_shading_vao);
+		glBindVertexArray(profiler_bars_for_simple_shading_vao);
+		glBindBuffer(GL_ARRAY_BUFFER, profiler_bars_vbo);
+		glVertexAttribPointer(simple_shading.Position_vec4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Position));
+		glEnableVertexAttribArray(simple_shading.Position_vec4);
+		if (simple_shading.Normal_vec3 != -1U) {
+			glVertexAttribPointer(simple_shading.Normal_vec3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Normal));
+			glEnableVertexAttribArray(simple_shading.Normal_vec3);
+		}
+		if (simple_shading.Color_vec4 != -1U) {
+			glVertexAttribPointer(simple_shading.Color_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Color));
+			glEnableVertexAttribArray(simple_shading.Color_vec4);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+
 	GL_ERRORS();
 
-	// NOTE: based on code from https://gist.github.com/armornick/3447121
 	// Sounds from https://freesound.org/people/morgantj/sounds/58634/
 	{ // Set up sound
-		d0.wav_buffer = new uint8_t [BUFFER_SIZE];
-		re.wav_buffer = new uint8_t [BUFFER_SIZE];
-		mi.wav_buffer = new uint8_t [BUFFER_SIZE];
-		fa.wav_buffer = new uint8_t [BUFFER_SIZE];
-		so.wav_buffer = new uint8_t [BUFFER_SIZE];
-
-		if (SDL_Init(SDL_INIT_AUDIO) < 0) {
+		if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
 			throw std::runtime_error("failed to init audio");
 		}
 
-		//TODO: ????????
-		if( SDL_LoadWAV("sounds/do (actually fa).wav", &d0.wav_spec, &d0.wav_buffer, &d0.wav_length) == NULL ){
-			throw std::runtime_error("failed to load audio");
+		//one device for the whole session, at the hardware's own rate (sounds are resampled to it when loaded)
+		// and in the format the mixer works in (SDL converts behind the scenes if the hardware wants another):
+		SDL_AudioSpec want;
+		SDL_memset(&want, 0, sizeof(want));
+		want.freq = 44100;
+		want.format = AUDIO_S16SYS;
+		want.channels = 2;
+		want.samples = BUFFER_SIZE;
+		want.callback = audio_callback;
+		want.userdata = &mixer;
+		SDL_AudioSpec have;
+		audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+		if (audio_device == 0) {
+			throw std::runtime_error(std::string("failed to open audio device: ") + SDL_GetError());
 		}
-		if( SDL_LoadWAV("sounds/re.wav", &re.wav_spec, &re.wav_buffer, &re.wav_length) == NULL ){
-			throw std::runtime_error("failed to load audio");
-		}
-		if( SDL_LoadWAV("sounds/mi.wav", &mi.wav_spec, &mi.wav_buffer, &mi.wav_length) == NULL ){
-			throw std::runtime_error("failed to load audio");
-		}
-		if( SDL_LoadWAV("sounds/fa (actually do).wav", &fa.wav_spec, &d0.wav_buffer, &fa.wav_length) == NULL ){
-			throw std::runtime_error("failed to load audio");
+
+		//notes are kept compressed: as packed by sounds/Makefile when that is at the device's rate,
+		// otherwise resampled from the .wav originals and packed the same way; each is read (and, if need
+		// be, resampled) by its own job, and they are handed to the mixer in order once all are loaded:
+		struct Note {
+			std::string name;
+			std::vector< uint8_t > blocks; //IMA-ADPCM
+			uint32_t frames = 0;
+		};
+		//(the 'do' and 'fa' files are named for each other's notes)
+		std::vector< Note > loaded(5);
+		loaded[0].name = "fa (actually do)";
+		loaded[1].name = "re";
+		loaded[2].name = "mi";
+		loaded[3].name = "do (actually fa)";
+		loaded[4].name = "so";
+		Jobs::Counter loading;
+		for (Note &note : loaded) {
+			jobs.run("load_sound", [&note, have]() {
+				std::ifstream packed(data_path("sounds/" + note.name + ".adpcm"), std::ios::binary);
+				if (packed) {
+					std::vector< Adpcm::Header > header;
+					read_chunk(packed, "adp0", &header);
+					read_chunk(packed, "adb0", &note.blocks);
+					if (header.size() != 1 || note.blocks.size() < (header[0].frames + Adpcm::BlockFrames - 1) / Adpcm::BlockFrames * Adpcm::BlockBytes) {
+						throw std::runtime_error("malformed sound '" + note.name + ".adpcm'");
+					}
+					if (header[0].rate == uint32_t(have.freq)) {
+						note.frames = header[0].frames;
+						return;
+					}
+				}
+				note.blocks = load_sound(data_path("sounds/" + note.name + ".wav"), have, &note.frames);
+			}, &loading);
 		}
-		if( SDL_LoadWAV("sounds/so.wav", &so.wav_spec, &so.wav_buffer, &so.wav_length) == NULL ){
-			throw std::runtime_error("failed to load audio");
+		jobs.wait(&loading); //(re-throws the first loading error)
+		for (Note &note : loaded) {
+			notes.emplace_back(mixer.add_adpcm(std::move(note.blocks), note.frames));
 		}
 
-		d0.wav_spec.callback = audio_callback;
-		re.wav_spec.callback = audio_callback;
-		mi.wav_spec.callback = audio_callback;
-		fa.wav_spec.callback = audio_callback;
-		so.wav_spec.callback = audio_callback;
+		//the device stays open (playing silence when no voice is active) until the Game is destroyed:
+		SDL_PauseAudioDevice(audio_device, 0);
+	}
 
-		d0.wav_spec.userdata = NULL;
-		re.wav_spec.userdata = NULL;
-		mi.wav_spec.userdata = NULL;
-		fa.wav_spec.userdata = NULL;
-		so.wav_spec.userdata = NULL;
+	{ // Set up meshes for the simulation's key counters (peanut, bread, jelly, serve):
+		key_counter_meshes = {
+			{&peanut_mesh, &peanut_gray},
+			{&bread_mesh, &bread_gray},
+			{&jelly_mesh, &jelly_gray},
+			{&serve_mesh, &serve_gray},
+		};
+		assert(key_counter_meshes.size() == Simulation::CounterCount);
+	}
+}
 
-		notes = {&d0, &re, &mi, &fa, &so};
-	};
+Game::~Game() {
+	glDeleteTextures(1, &board_composite.color_tex);
+	board_composite.color_tex = -1U;
 
-	{ // Set up game state and level
-		left.is_row = 0; 		left.is_end = 0;
-		top.is_end = 0;			top.is_row = 1;
-		right.is_row = 0;		right.is_end = 1;
-		bottom.is_end = 1;		bottom.is_row = 1;
+	glDeleteTextures(1, &board_composite.depth_tex);
+	board_composite.depth_tex = -1U;
 
-		edges = {&top, &bottom, &left, &right};
+	glDeleteFramebuffers(1, &board_composite.framebuffer);
+	board_composite.framebuffer = -1U;
 
-		peanut.active = &peanut_mesh;	peanut.inactive = &peanut_gray;
-		bread.active = &bread_mesh;		bread.inactive = &bread_gray;
-		jelly.active = &jelly_mesh;		jelly.inactive = &jelly_gray;
-		serve.active = &serve_mesh;		serve.inactive = &serve_gray;
+	glDeleteVertexArrays(1, &board_composite.empty_vao);
+	board_composite.empty_vao = -1U;
 
-		key_counters = {&peanut, &bread, &jelly, &serve};
+	glDeleteProgram(board_composite.program);
+	board_composite.program = -1U;
 
-		level_progression = {&bread, &peanut, &jelly, &bread, &serve};
-		generate_level();
-	}
-}
+	glDeleteVertexArrays(1, &profiler_bars_for_simple_shading_vao);
+	profiler_bars_for_simple_shading_vao = -1U;
+
+	glDeleteBuffers(1, &profiler_bars_vbo);
+	profiler_bars_vbo = -1U;
 
-Game::~Game() {
 	glDeleteVertexArrays(1, &meshes_for_simple_shading_vao);
 	meshes_for_simple_shading_vao = -1U;
 
@@ -308,68 +382,13 @@ Game::~Game() {
 	glDeleteProgram(simple_shading.program);
 	simple_shading.program = -1U;
 
-	SDL_CloseAudio();
-	SDL_FreeWAV(d0.wav_buffer);
-    SDL_FreeWAV(re.wav_buffer);
-    SDL_FreeWAV(mi.wav_buffer);
-    SDL_FreeWAV(fa.wav_buffer);
-    SDL_FreeWAV(so.wav_buffer);
+	//(stops the callback before the mixer it reads from goes away)
+	SDL_CloseAudioDevice(audio_device);
+	audio_device = 0;
 
 	GL_ERRORS();
 }
 
-void Game::generate_level() {
-    auto near_others = [&](uint32_t index, glm::uvec3 location) {
-            for (uint32_t i = 0; i < index; ++i) {
-                if (adjacent(key_counters[i]->location, location, 1.0f)) {
-                    return true;
-                }
-            }
-            return false;
-    };
-
-    // Randomly place key counters on edges
-	std::set< Edge *> remaining_edges = edges;
-	for (uint32_t i = 0; i < 4; ++i) {
-		Edge *edge = *std::next(remaining_edges.begin(), rand()%remaining_edges.size());
-
-		uint32_t max = board_size[edge->is_row];
-		uint32_t increment = edge->is_row ? board_size.x : 1;
-		uint32_t start = edge->is_end * (edge->is_row ? board_size.x-1 : board_size.x*(board_size.y-1));
-
-        uint32_t placement = 1 + rand() % (max-2);
-
-		uint32_t index = start + placement * increment;
-		uint32_t x = index / board_size.x;
-		uint32_t y = index % board_size.x;
-		glm::uvec3 location = glm::uvec3(x, y, 0.0f);
-
-        // Make sure counter doesn't spawn near avatar or each other
-        uint32_t start_placement = placement;
-        while (adjacent(location, avatar_location, 1.0f) || near_others(i, location)) {
-            placement = 1 + (placement + 1) % (max - 2);
-			if (placement == start_placement) {
-				break;
-			}
-            uint32_t index = start + placement * increment;
-            uint32_t x = index / board_size.x;
-            uint32_t y = index % board_size.x;
-            location = glm::uvec3(x, y, 0.0f);
-        }
-
-		CounterInfo *counter = key_counters[i];
-		counter->location = location;
-
-		// Rotate the serve counter to point outwards
-		if (i == 3) {
-            counter->rotation = glm::quat(glm::vec3(0.0f, 0.0f,
-                    glm::radians((edge->is_row) * 90.0f + (edge->is_end) * 180.0f)));
-		}
-
-		remaining_edges.erase(edge);
-	}
-}
-
 bool Game::handle_event(SDL_Event const &evt, glm::uvec2 window_size) {
     //ignore any keys that are the result of automatic key repeat:
     if (evt.type == SDL_KEYDOWN && evt.key.repeat) {
@@ -378,16 +397,23 @@ bool Game::handle_event(SDL_Event const &evt, glm::uvec2 window_size) {
     //handle tracking the state of WASD for avatar movement:
 	if (evt.type == SDL_KEYDOWN || evt.type == SDL_KEYUP) {	// Press/release keys
 		if (evt.key.keysym.scancode == SDL_SCANCODE_W) {
-			controls.go_up = (evt.type == SDL_KEYDOWN);
+			sim.controls.go_up = (evt.type == SDL_KEYDOWN);
 			return true;
 		} else if (evt.key.keysym.scancode == SDL_SCANCODE_S) {
-			controls.go_down = (evt.type == SDL_KEYDOWN);
+			sim.controls.go_down = (evt.type == SDL_KEYDOWN);
 			return true;
 		} else if (evt.key.keysym.scancode == SDL_SCANCODE_A) {
-			controls.go_left = (evt.type == SDL_KEYDOWN);
+			sim.controls.go_left = (evt.type == SDL_KEYDOWN);
 			return true;
 		} else if (evt.key.keysym.scancode == SDL_SCANCODE_D) {
-			controls.go_right = (evt.type == SDL_KEYDOWN);
+			sim.controls.go_right = (evt.type == SDL_KEYDOWN);
+			return true;
+		} else if (evt.key.keysym.scancode == SDL_SCANCODE_P) {
+			//toggle the profiler overlay (draw prints its legend, since the profiler belongs to the render thread):
+			if (evt.type == SDL_KEYDOWN) {
+				show_profiler = !show_profiler;
+				needs_redraw = true;
+			}
 			return true;
 		}
   	}
@@ -395,97 +421,64 @@ bool Game::handle_event(SDL_Event const &evt, glm::uvec2 window_size) {
 	return false;
 }
 
-void Game::update(float elapsed) {
+bool Game::is_idle() const {
+	//(a bot decides on input during update, so it never waits for events)
+	return !bot && sim.is_idle();
+}
 
-    // --------------- Progress -------------------------------
-    {
-    	CounterInfo *next_counter = level_progression[next_pickup];
-    	if (adjacent(next_counter->location, avatar_location, 0.5f)) {
-
-    		// play sound
-    		Sound *next_note = notes[next_pickup];
-    		current_audio_pos = next_note->wav_buffer;
-    		current_audio_len = next_note->wav_length;
-    		if (SDL_OpenAudio(&(next_note->wav_spec), NULL) >= 0) {
-    			SDL_PauseAudio(0);
-    		}
-
-    		++next_pickup;
-    		if (next_pickup == level_progression.size()) {
-	        	++num_sandwiches;
-	        	next_pickup = 0;
-	        	generate_level();
-    		}
-    	}
-    }
+bool Game::interpolating() const {
+	return previous_avatar_location != sim.avatar_location || previous_avatar_rotation != sim.avatar_rotation;
+}
 
-	// --------------- Physics-based movement ---------------
+void Game::update(float elapsed) {
+	//if the last step moved the avatar, the most recent frame may have been drawn short of its final pose:
+	if (interpolating()) {
+		needs_redraw = true;
+	}
 
-    // NOTE: Movement based on discussion from http://www.cplusplus.com/forum/general/29835/
-    // Default avatar orientation is (1,0);
-    {
-        if (controls.go_left) {
-            x_velocity -= elapsed * acceleration;
-            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(180.0f)));
-        }
-        if (controls.go_up) {
-            y_velocity += elapsed * acceleration;
-            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(90.0f)));
-        }
-        if (controls.go_right) {
-            x_velocity += elapsed * acceleration;
-            avatar_rotation = glm::quat();
-        }
-        if (controls.go_down) {
-            y_velocity -= elapsed * acceleration;
-            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(-90.0f)));
-        }
+	//remember the visible state, both for interpolation in draw and to tell main.cpp if this update changed anything:
+	previous_avatar_location = sim.avatar_location;
+	previous_avatar_rotation = sim.avatar_rotation;
+	uint8_t old_next_pickup = sim.next_pickup;
 
-        // Decelerate to a stop
-        if (!controls.go_left && !controls.go_right && x_velocity != 0.0f) {
-        	int sign = x_velocity < 0 ? -1 : 1;
-            x_velocity -= sign * deceleration * elapsed;
+	level_prefetch.update(&sim);
+	if (bot) bot_fields.drive(&sim);
+	sim.update(elapsed);
 
-            if (sign > 0) {
-            	x_velocity = glm::clamp(x_velocity, 0.0f, max_velocity);
-            } else {
-            	x_velocity = glm::clamp(x_velocity, -max_velocity, 0.0f);
-            }
-        }
-        if (!controls.go_up && !controls.go_down && y_velocity != 0.0f) {
-			int sign = y_velocity < 0 ? -1 : 1;
-			y_velocity -= sign * deceleration * elapsed;
-
-			if (sign > 0) {
-				y_velocity = glm::clamp(y_velocity, 0.0f, max_velocity);
-			} else {
-				y_velocity = glm::clamp(y_velocity, -max_velocity, 0.0f);
-			}
-        }
+	if (sim.picked_up >= 0) {
+		//notes lean toward the side of the board the avatar is on:
+		float pan = 0.5f * (2.0f * sim.avatar_location.x / std::max(1.0f, float(sim.board_size.x) - 1.0f) - 1.0f);
+		mixer.play(notes[sim.picked_up], AUDIO_VOLUME, pan);
+	}
 
-        x_velocity = glm::clamp(x_velocity, -max_velocity, max_velocity);
-        y_velocity = glm::clamp(y_velocity, -max_velocity, max_velocity);
-        assert(-max_velocity <= x_velocity && x_velocity <= max_velocity);
-        assert(-max_velocity <= y_velocity && y_velocity <= max_velocity);
-        glm::vec3 mv = x_velocity * glm::vec3(1.0f, 0.0f, 0.0f) + y_velocity * glm::vec3(0.0f, 1.0f, 0.0f);
-
-        if (mv != glm::vec3(0.0f, 0.0f, 0.0f)) {
-            avatar_location += mv;
-            avatar_location.x = glm::clamp(avatar_location.x, 1.0f, (float) board_size.x - 2);
-            avatar_location.y = glm::clamp(avatar_location.y, 1.0f, (float) board_size.y - 2);
-
-            // Prevent avatar from "sticking" to counters
-            if (avatar_location.x == 1.0f || avatar_location.x == board_size.x - 2) {
-                x_velocity = 0.0f;
-            }
-            if (avatar_location.y == 1.0f || avatar_location.y == board_size.y - 2) {
-                y_velocity = 0.0f;
-            }
-        }
-    }
+	if (interpolating() || sim.next_pickup != old_next_pickup) {
+		needs_redraw = true;
+	}
 }
 
-void Game::draw(glm::uvec2 drawable_size) {
+Game::FramePacket Game::make_frame(glm::uvec2 drawable_size, float alpha) const {
+	FramePacket frame;
+	frame.drawable_size = drawable_size;
+	frame.alpha = alpha;
+	frame.previous_avatar_location = previous_avatar_location;
+	frame.previous_avatar_rotation = previous_avatar_rotation;
+	frame.avatar_location = sim.avatar_location;
+	frame.avatar_rotation = sim.avatar_rotation;
+	frame.board_size = sim.board_size;
+	frame.level = sim.level;
+	for (uint32_t i = 0; i < Simulation::CounterCount; ++i) {
+		frame.counters[i] = sim.counters[i];
+	}
+	frame.current_counter = sim.level_progression[sim.next_pickup];
+	frame.num_sandwiches = sim.num_sandwiches;
+	frame.show_profiler = show_profiler;
+	return frame;
+}
+
+void Game::draw(FramePacket const &frame) {
+	glm::uvec2 drawable_size = frame.drawable_size;
+	glm::uvec2 board_size = frame.board_size;
+
 	//Set up a transformation matrix to fit the board in the window:
 	glm::mat4 world_to_clip;
 	{
@@ -510,31 +503,32 @@ void Game::draw(glm::uvec2 drawable_size) {
 	}
 
 	//set up graphics pipeline to use data from the meshes and the simple shading program:
-	glBindVertexArray(meshes_for_simple_shading_vao);
-	glUseProgram(simple_shading.program);
+	// (bindings and uniforms go through gl_state, which drops the ones that are already current)
+	gl_state.bind_vertex_array(meshes_for_simple_shading_vao);
+	gl_state.use_program(simple_shading.program);
 
-	glUniform3fv(simple_shading.sun_color_vec3, 1, glm::value_ptr(glm::vec3(0.81f, 0.81f, 0.76f)));
-	glUniform3fv(simple_shading.sun_direction_vec3, 1, glm::value_ptr(glm::normalize(glm::vec3(0.4f, -0.4f, 1.0f))));
-	glUniform3fv(simple_shading.sky_color_vec3, 1, glm::value_ptr(glm::vec3(0.2f, 0.2f, 0.3f)));
-	glUniform3fv(simple_shading.sky_direction_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 1.0f, 0.0f)));
+	gl_state.uniform(simple_shading.sun_color_vec3, glm::vec3(0.81f, 0.81f, 0.76f));
+	gl_state.uniform(simple_shading.sun_direction_vec3, glm::normalize(glm::vec3(0.4f, -0.4f, 1.0f)));
+	gl_state.uniform(simple_shading.sky_color_vec3, glm::vec3(0.2f, 0.2f, 0.3f));
+	gl_state.uniform(simple_shading.sky_direction_vec3, glm::vec3(0.0f, 1.0f, 0.0f));
 
 	//helper function to draw a given mesh with a given transformation:
 	auto draw_mesh = [&](Mesh const &mesh, glm::mat4 const &object_to_world) {
 		//set up the matrix uniforms:
 		if (simple_shading.object_to_clip_mat4 != -1U) {
 			glm::mat4 object_to_clip = world_to_clip * shear_z * scale_z * object_to_world;
-			glUniformMatrix4fv(simple_shading.object_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+			gl_state.uniform(simple_shading.object_to_clip_mat4, object_to_clip);
 		}
 		if (simple_shading.object_to_light_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(simple_shading.object_to_light_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_world));
+			gl_state.uniform(simple_shading.object_to_light_mat4x3, glm::mat4x3(object_to_world));
 		}
 		if (simple_shading.normal_to_light_mat3 != -1U) {
 			//NOTE: if there isn't any non-uniform scaling in the object_to_world matrix, then the inverse transpose is the matrix itself, and computing it wastes some CPU time:
 			glm::mat3 normal_to_world = glm::inverse(glm::transpose(glm::mat3(object_to_world)));
-			glUniformMatrix3fv(simple_shading.normal_to_light_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_world));
+			gl_state.uniform(simple_shading.normal_to_light_mat3, normal_to_world);
 		}
         if (simple_shading.model_scale_mat4 != -1U) {
-            glUniformMatrix4fv(simple_shading.model_scale_mat4, 1, GL_FALSE, glm::value_ptr(model));
+            gl_state.uniform(simple_shading.model_scale_mat4, model);
         }
 
 		//draw the mesh:
@@ -547,38 +541,88 @@ void Game::draw(glm::uvec2 drawable_size) {
 
 	auto not_occupied = [&](const uint32_t x, const uint32_t y) -> bool {
         glm::uvec3 compare = glm::uvec3(x,y,0);
-        for (CounterInfo *c : key_counters) {
-			if (c->location == compare) {
+        for (Simulation::CounterInfo const &c : frame.counters) {
+			if (c.location == compare) {
 				return false;
 			}
         }
         return true;
 	};
 
-	for (uint32_t i = 0; i < board_size.x * board_size.y; ++i) {
-		uint32_t x = i / board_size.x;
-		uint32_t y = i % board_size.y;
-		draw_mesh(tile_mesh, location_v3m4(glm::vec3(x, y, -0.5f), glm::quat()));
+	//the static board layer (floor tiles and plain counters) only changes with the level,
+	// so it is rendered into an offscreen color+depth target and re-used until then:
+	if (board_composite.level != frame.level || board_composite.size != drawable_size) {
+		if (board_composite.size != drawable_size) {
+			board_composite.size = drawable_size;
+
+			gl_state.bind_texture(0, GL_TEXTURE_2D, board_composite.color_tex);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, drawable_size.x, drawable_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+			gl_state.bind_texture(1, GL_TEXTURE_2D, board_composite.depth_tex);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, drawable_size.x, drawable_size.y, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+			gl_state.bind_framebuffer(board_composite.framebuffer);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, board_composite.color_tex, 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, board_composite.depth_tex, 0);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				throw std::runtime_error("board cache framebuffer is incomplete.");
+			}
+		}
+
+		//(clears to the same color main.cpp uses for the window)
+		gl_state.bind_framebuffer(board_composite.framebuffer);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		for (uint32_t i = 0; i < board_size.x * board_size.y; ++i) {
+			uint32_t x = i / board_size.x;
+			uint32_t y = i % board_size.y;
+			draw_mesh(tile_mesh, location_v3m4(glm::vec3(x, y, -0.5f), glm::quat()));
 
-		if (on_edge(x,y) && not_occupied(x,y)) {
-			draw_mesh(counter_mesh, location_v3m4(glm::vec3(x,y,0.0f), glm::quat()));
+			if (on_edge(x,y) && not_occupied(x,y)) {
+				draw_mesh(counter_mesh, location_v3m4(glm::vec3(x,y,0.0f), glm::quat()));
+			}
 		}
+
+		gl_state.bind_framebuffer(0);
+		board_composite.level = frame.level;
 	}
 
-	draw_mesh(avatar_mesh, location_v3m4(avatar_location, avatar_rotation));
+	{ //copy the cached board layer (including depth, so the dynamic objects below are occluded correctly):
+		gl_state.use_program(board_composite.program);
+		gl_state.bind_vertex_array(board_composite.empty_vao);
+		gl_state.bind_texture(0, GL_TEXTURE_2D, board_composite.color_tex);
+		gl_state.bind_texture(1, GL_TEXTURE_2D, board_composite.depth_tex);
+		gl_state.disable(GL_BLEND);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		gl_state.enable(GL_BLEND);
+
+		gl_state.use_program(simple_shading.program);
+		gl_state.bind_vertex_array(meshes_for_simple_shading_vao);
+	}
+
+	//dynamic layer: avatar, key counters, and text:
+
+	//avatar is drawn between its last two simulated poses, so motion stays smooth at any display rate:
+	glm::vec3 draw_location = glm::mix(frame.previous_avatar_location, frame.avatar_location, frame.alpha);
+	glm::quat draw_rotation = glm::slerp(frame.previous_avatar_rotation, frame.avatar_rotation, frame.alpha);
+	draw_mesh(avatar_mesh, location_v3m4(draw_location, draw_rotation));
 
-	CounterInfo *current_counter = level_progression[next_pickup];
-	for (CounterInfo *c : key_counters) {
-		if (c == current_counter) {
-			draw_mesh(*(c->active), location_v3m4(c->location, c->rotation));
+	for (uint32_t i = 0; i < Simulation::CounterCount; ++i) {
+		Simulation::CounterInfo const &c = frame.counters[i];
+		if (i == frame.current_counter) {
+			draw_mesh(*key_counter_meshes[i].active, location_v3m4(c.location, c.rotation));
 		} else {
-			draw_mesh(*(c->inactive), location_v3m4(c->location, c->rotation));
+			draw_mesh(*key_counter_meshes[i].inactive, location_v3m4(c.location, c.rotation));
 		}
 	}
 
 	auto draw_text = [&](Mesh const &mesh, glm::mat4 const &object_to_world) {
 		glm::mat4 object_to_clip = world_to_clip * object_to_world;
-		glUniformMatrix4fv(simple_shading.object_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+		gl_state.uniform(simple_shading.object_to_clip_mat4, object_to_clip);
 
 		glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
 	};
@@ -589,10 +633,10 @@ void Game::draw(glm::uvec2 drawable_size) {
 	text_point.x += 3.8f;
 	text_point.y -= 0.01f;
 
-	if (num_sandwiches == 0) {
+	if (frame.num_sandwiches == 0) {
 		draw_text(num0, location_v3m4(text_point, glm::quat()));
 	} else {
-		uint32_t num_to_show = num_sandwiches;
+		uint32_t num_to_show = frame.num_sandwiches;
 		std::vector< uint32_t > order;
 
 		while (num_to_show > 0) {
@@ -608,9 +652,107 @@ void Game::draw(glm::uvec2 drawable_size) {
 		}
 	}
 
-	glUseProgram(0);
+	if (frame.show_profiler) {
+		//print a legend when the overlay appears, since the overlay has no labels:
+		if (!profiler_shown) {
+			std::cout << "Profiler (bars: cpu left, gpu right; full height = 16.7ms):" << std::endl;
+			for (uint32_t i = 0; i < profiler.scopes.size(); ++i) {
+				std::cout << "  row " << i << " '" << profiler.scopes[i].name << "': "
+					<< profiler.average_cpu_ms(i) << "ms cpu";
+				if (profiler.scopes[i].gpu) {
+					std::cout << ", " << profiler.average_gpu_ms(i) << "ms gpu";
+				}
+				std::cout << std::endl;
+			}
+			std::cout << "  gl state calls last frame: " << gl_state.last_frame_stats.submitted
+				<< " submitted, " << gl_state.last_frame_stats.elided << " elided" << std::endl;
+		}
+		draw_profiler();
+	}
+	profiler_shown = frame.show_profiler;
 
-	GL_ERRORS();
+	//NOTE: the program and VAO are intentionally left bound, so next frame's binds are elided.
+	//(main.cpp checks for GL errors after each frame, timed as its own phase)
+}
+
+void Game::draw_profiler() {
+	//overlay occupies the bottom of the screen, one strip per scope, drawn directly in clip space:
+	const float left = -0.95f;
+	const float right = 0.95f;
+	const float bottom = -0.95f;
+	const float strip_height = 0.1f;
+	const float full_scale_ms = 1000.0f / 60.0f;
+
+	//colors cycled through for successive scopes:
+	static const glm::u8vec4 palette[] = {
+		glm::u8vec4(0xee, 0x44, 0x44, 0xdd),
+		glm::u8vec4(0x44, 0xcc, 0x44, 0xdd),
+		glm::u8vec4(0x44, 0x88, 0xee, 0xdd),
+		glm::u8vec4(0xee, 0xcc, 0x33, 0xdd),
+		glm::u8vec4(0xcc, 0x44, 0xcc, 0xdd),
+		glm::u8vec4(0x44, 0xcc, 0xcc, 0xdd),
+	};
+	const uint32_t palette_size = sizeof(palette) / sizeof(palette[0]);
+
+	std::vector< Vertex > verts;
+	verts.reserve(profiler.scopes.size() * Profiler::HistoryLength * 2 * 6 + 6);
+
+	auto quad = [&verts](float x0, float y0, float x1, float y1, glm::u8vec4 color) {
+		glm::vec3 n = glm::vec3(0.0f, 0.0f, 1.0f);
+		verts.emplace_back(Vertex{glm::vec3(x0, y0, 0.0f), n, color});
+		verts.emplace_back(Vertex{glm::vec3(x1, y0, 0.0f), n, color});
+		verts.emplace_back(Vertex{glm::vec3(x1, y1, 0.0f), n, color});
+		verts.emplace_back(Vertex{glm::vec3(x0, y0, 0.0f), n, color});
+		verts.emplace_back(Vertex{glm::vec3(x1, y1, 0.0f), n, color});
+		verts.emplace_back(Vertex{glm::vec3(x0, y1, 0.0f), n, color});
+	};
+
+	//dark backdrop behind all the strips:
+	quad(left, bottom, right, bottom + strip_height * profiler.scopes.size(), glm::u8vec4(0x00, 0x00, 0x00, 0x88));
+
+	float column = (right - left) / float(Profiler::HistoryLength);
+	for (uint32_t s = 0; s < profiler.scopes.size(); ++s) {
+		Profiler::Scope const &scope = profiler.scopes[s];
+		glm::u8vec4 cpu_color = palette[s % palette_size];
+		glm::u8vec4 gpu_color = glm::u8vec4(cpu_color.x / 2 + 0x7f, cpu_color.y / 2 + 0x7f, cpu_color.z / 2 + 0x7f, cpu_color.w);
+		float y0 = bottom + s * strip_height;
+
+		//oldest frame on the left, newest on the right:
+		for (uint32_t i = 0; i < Profiler::HistoryLength; ++i) {
+			uint32_t slot = (profiler.frame + 1 + i) % Profiler::HistoryLength;
+			float x0 = left + i * column;
+			float cpu = glm::min(scope.cpu_ms[slot] / full_scale_ms, 1.0f);
+			if (cpu > 0.0f) {
+				quad(x0, y0, x0 + 0.5f * column, y0 + cpu * strip_height, cpu_color);
+			}
+			if (scope.gpu && scope.gpu_ms[slot] > 0.0f) {
+				float gpu = glm::min(scope.gpu_ms[slot] / full_scale_ms, 1.0f);
+				quad(x0 + 0.5f * column, y0, x0 + column, y0 + gpu * strip_height, gpu_color);
+			}
+		}
+	}
+
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, profiler_bars_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * verts.size(), verts.data(), GL_STREAM_DRAW);
+
+	//vertices are already in clip space, so all transforms are identity:
+	glm::mat4 identity = glm::mat4(1.0f);
+	gl_state.uniform(simple_shading.object_to_clip_mat4, identity);
+	if (simple_shading.model_scale_mat4 != -1U) {
+		gl_state.uniform(simple_shading.model_scale_mat4, identity);
+	}
+	if (simple_shading.object_to_light_mat4x3 != -1U) {
+		gl_state.uniform(simple_shading.object_to_light_mat4x3, glm::mat4x3(identity));
+	}
+	if (simple_shading.normal_to_light_mat3 != -1U) {
+		gl_state.uniform(simple_shading.normal_to_light_mat3, glm::mat3(1.0f));
+	}
+
+	gl_state.disable(GL_DEPTH_TEST);
+	gl_state.bind_vertex_array(profiler_bars_for_simple_shading_vao);
+	glDrawArrays(GL_TRIANGLES, 0, GLsizei(verts.size()));
+	gl_state.bind_vertex_array(meshes_for_simple_shading_vao);
+	gl_state.enable(GL_DEPTH_TEST);
 }
 
 static glm::mat4 location_v3m4(glm::vec3 v, glm::quat r) {
@@ -622,35 +764,139 @@ static glm::mat4 location_v3m4(glm::vec3 v, glm::quat r) {
 	) * glm::mat4_cast(r);
 }
 
-// Positions on grid where locationB is adjacent to locationA with leeway of 0.0f:
-//          B B B
-//          B A B
-//          B B B
-static bool adjacent(glm::vec3 locationA, glm::vec3 locationB, float leeway) {
-    float x_lo = locationA.x - 1.0f - leeway;
-    float x_hi = locationA.x + 2.0f + leeway;
-    float y_lo = locationA.y - 1.0f - leeway;
-    float y_hi = locationA.y + 2.0f + leeway;
-
-    if ((locationB.x >= x_lo && locationB.x + 1.0f <= x_hi) &&
-        (locationB.y >= y_lo && locationB.y + 1.0f <= y_hi)) {
-        return true;
-    }
-    return false;
+//runs on SDL's audio thread; 'userdata' is the Game's mixer:
+static void audio_callback(void *userdata, Uint8 *stream, int len) {
+	Mixer *mixer = reinterpret_cast< Mixer * >(userdata);
+	mixer->mix(reinterpret_cast< int16_t * >(stream), uint32_t(len) / (2 * sizeof(int16_t)));
 }
 
+//converted sounds are cached next to the originals as "<file>.<rate>.adpcm":
+// "pch0": one SoundCacheHeader identifying the source file and rate
+// "adp0", "adb0": the sound at that rate, packed as in Adpcm.hpp
+struct SoundCacheHeader {
+	uint32_t rate;
+	uint32_t source_bytes;
+	uint64_t source_hash; //FNV-1a of the source file's bytes
+};
+static_assert(sizeof(SoundCacheHeader) == 16, "SoundCacheHeader should be packed.");
+
+//load a .wav file, convert it to the device's rate as stereo 16-bit samples, and pack those as IMA-ADPCM
+// blocks of '*frames' frames; throws on failure.
+//Rate changes go through Resampler (windowed sinc) and the result is cached on disk, so later runs just read it back:
 // NOTE: based on code from https://gist.github.com/armornick/3447121
-static void audio_callback(void *userdata, Uint8 *stream, int len) {
-	if (current_audio_len == 0) {
-		return;
+static std::vector< uint8_t > load_sound(std::string const &filename, SDL_AudioSpec const &device_spec, uint32_t *frames_) {
+	//identify the source by its contents (cheap next to resampling it):
+	SoundCacheHeader source;
+	source.rate = uint32_t(device_spec.freq);
+	{
+		std::ifstream file(filename, std::ios::binary);
+		std::vector< char > bytes((std::istreambuf_iterator< char >(file)), std::istreambuf_iterator< char >());
+		if (!file && !file.eof()) {
+			throw std::runtime_error("failed to read audio '" + filename + "'");
+		}
+		source.source_bytes = uint32_t(bytes.size());
+		source.source_hash = 0xcbf29ce484222325ULL;
+		for (char c : bytes) {
+			source.source_hash = (source.source_hash ^ uint8_t(c)) * 0x100000001b3ULL;
+		}
 	}
 
-	len = ( len > (int)current_audio_len ? current_audio_len : len );
-    SDL_memset(stream, 0, len);
-    SDL_MixAudio(stream, current_audio_pos, len, AUDIO_VOLUME);
+	std::string cache_filename = filename + "." + std::to_string(device_spec.freq) + ".adpcm";
+	try {
+		std::ifstream cache(cache_filename, std::ios::binary);
+		if (cache) {
+			std::vector< SoundCacheHeader > header;
+			std::vector< Adpcm::Header > packed;
+			std::vector< uint8_t > blocks;
+			read_chunk(cache, "pch0", &header);
+			read_chunk(cache, "adp0", &packed);
+			read_chunk(cache, "adb0", &blocks);
+			if (header.size() == 1 && std::memcmp(&header[0], &source, sizeof(source)) == 0
+			 && packed.size() == 1 && blocks.size() == (packed[0].frames + Adpcm::BlockFrames - 1) / Adpcm::BlockFrames * Adpcm::BlockBytes) {
+				*frames_ = packed[0].frames;
+				return blocks;
+			}
+		}
+	} catch (std::runtime_error &) {
+		//(a damaged or outdated cache is just rebuilt)
+	}
 
-	current_audio_pos += len;
-	current_audio_len -= len;
+	SDL_AudioSpec spec;
+	Uint8 *buffer = nullptr;
+	Uint32 length = 0;
+	if (SDL_LoadWAV(filename.c_str(), &spec, &buffer, &length) == NULL) {
+		throw std::runtime_error("failed to load audio '" + filename + "': " + SDL_GetError());
+	}
+
+	//SDL only changes the sample format and channel count (its own rate conversion is low quality):
+	SDL_AudioCVT cvt;
+	if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq, AUDIO_F32SYS, 2, spec.freq) < 0) {
+		SDL_FreeWAV(buffer);
+		throw std::runtime_error("can't convert audio '" + filename + "': " + SDL_GetError());
+	}
+	std::vector< Uint8 > converted(length * (cvt.len_mult > 0 ? cvt.len_mult : 1));
+	std::memcpy(converted.data(), buffer, length);
+	SDL_FreeWAV(buffer);
+	cvt.buf = converted.data();
+	cvt.len = int(length);
+	if (cvt.needed && SDL_ConvertAudio(&cvt) < 0) {
+		throw std::runtime_error("failed to convert audio '" + filename + "': " + SDL_GetError());
+	}
+	uint32_t bytes = uint32_t(cvt.needed ? cvt.len_cvt : cvt.len);
+	uint32_t frames = bytes / (2 * sizeof(float));
+
+	std::vector< float > stereo(2 * frames);
+	std::memcpy(stereo.data(), converted.data(), stereo.size() * sizeof(float));
+	Resampler resampler(uint32_t(spec.freq), uint32_t(device_spec.freq));
+	std::vector< float > resampled = resampler.resample(stereo.data(), frames, 2);
+
+	std::vector< int16_t > samples(resampled.size());
+	for (uint32_t i = 0; i < samples.size(); ++i) {
+		samples[i] = int16_t(std::lrint(std::min(std::max(resampled[i] * 32768.0f, -32768.0f), 32767.0f)));
+	}
+	Adpcm::Header packed;
+	packed.rate = source.rate;
+	packed.frames = uint32_t(samples.size() / 2);
+	std::vector< uint8_t > blocks = Adpcm::encode(samples.data(), packed.frames);
+
+	//(if the data directory isn't writable, the conversion is simply redone next time)
+	std::ofstream cache(cache_filename, std::ios::binary);
+	write_chunk("pch0", std::vector< SoundCacheHeader >(1, source), &cache);
+	write_chunk("adp0", std::vector< Adpcm::Header >(1, packed), &cache);
+	write_chunk("adb0", blocks, &cache);
+	if (!cache) {
+		cache.close();
+		std::remove(cache_filename.c_str());
+	}
+
+	*frames_ = packed.frames;
+	return blocks;
+}
+
+//link a program from the given shaders (which are released); throws if linking fails:
+static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader) {
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, fragment_shader);
+	//shaders are reference counted so this makes sure they are freed after program is deleted:
+	glDeleteShader(vertex_shader);
+	glDeleteShader(fragment_shader);
+
+	//link the shader program and throw errors if linking fails:
+	glLinkProgram(program);
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE) {
+		std::cerr << "Failed to link shader program." << std::endl;
+		GLint info_log_length = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);
+		std::vector< GLchar > info_log(info_log_length, 0);
+		GLsizei length = 0;
+		glGetProgramInfoLog(program, GLsizei(info_log.size()), &length, &info_log[0]);
+		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
+		throw std::runtime_error("failed to link program");
+	}
+	return program;
 }
 
 //create and return an OpenGL vertex shader from source:
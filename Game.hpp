@@ -1,6 +1,13 @@
 #pragma once
 
 #include "GL.hpp"
+#include "Profiler.hpp"
+#include "GLState.hpp"
+#include "Simulation.hpp"
+#include "LevelPrefetch.hpp"
+#include "Bots.hpp"
+#include "Mixer.hpp"
+#include "Jobs.hpp"
 
 #include <SDL.h>
 #include <glm/glm.hpp>
@@ -8,7 +15,6 @@
 #include <glm/gtc/quaternion.hpp>
 
 #include <vector>
-#include <set>
 
 // The 'Game' struct holds all of the game-relevant state,
 // and is called by the main loop.
@@ -16,7 +22,8 @@
 struct Game {
 	//Game creates OpenGL resources (i.e. vertex buffer objects) in its
 	//constructor and frees them in its destructor.
-	Game();
+	//'seed' determines the sequence of levels generated:
+	Game(uint64_t seed);
 	~Game();
 
 	//handle_event is called when new mouse or keyboard events are received:
@@ -24,11 +31,49 @@ struct Game {
 	//The function should return 'true' if it handled the event.
 	bool handle_event(SDL_Event const &evt, glm::uvec2 window_size);
 
-	//update is called at the start of a new frame, after events are handled:
+	//update advances the simulation (sim) by one fixed-length step:
+	// (main.cpp calls it zero or more times per frame, after events are handled)
 	void update(float elapsed);
 
-	//draw is called after update:
-	void draw(glm::uvec2 drawable_size);
+	//everything draw needs from the game state for one frame, copied out by
+	//make_frame on the simulation thread and handed to the render thread (main.cpp),
+	//so draw never reads 'sim' while update is changing it:
+	struct FramePacket {
+		glm::uvec2 drawable_size = glm::uvec2(0, 0);
+		float alpha = 0.0f; //in [0,1]: how far the frame lies between the previous and the current simulation step
+
+		//avatar pose at the start and end of the latest update step (draw interpolates by alpha):
+		glm::vec3 previous_avatar_location = glm::vec3(0.0f);
+		glm::quat previous_avatar_rotation = glm::quat();
+		glm::vec3 avatar_location = glm::vec3(0.0f);
+		glm::quat avatar_rotation = glm::quat();
+
+		glm::uvec2 board_size = glm::uvec2(0, 0);
+		uint32_t level = -1U;
+		Simulation::CounterInfo counters[Simulation::CounterCount];
+		uint32_t current_counter = 0; //the counter to visit next (drawn active)
+		uint32_t num_sandwiches = 0;
+
+		bool show_profiler = false;
+		uint32_t sequence = 0; //main.cpp numbers the packets it publishes
+		double update_ms = 0.0; //total time main.cpp has spent in update so far (for the render thread's profiler)
+	};
+
+	//make_frame is called after update:
+	FramePacket make_frame(glm::uvec2 drawable_size, float alpha) const;
+
+	//draw renders one frame packet; it touches only GL resources and the profiler, never 'sim':
+	void draw(FramePacket const &frame);
+
+	//needs_redraw is set whenever something visible changes (by update or handle_event);
+	// main.cpp skips making frames while it is false and clears it after publishing one:
+	bool needs_redraw = true;
+
+	//is_idle returns true if update would not change anything (no movement keys held, avatar at rest):
+	bool is_idle() const;
+
+	//interpolating returns true while draw's output still depends on 'alpha':
+	bool interpolating() const;
 
 	//------- opengl resources -------
 
@@ -72,6 +117,36 @@ struct Game {
 
 	GLuint meshes_for_simple_shading_vao = -1U; //vertex array object that describes how to connect the meshes_vbo to the simple_shading_program
 
+	//cache of bound objects/enables/uniform values used to drop redundant GL calls
+	// (resources are created directly in the constructor; everything per-frame goes through gl_state):
+	GLState gl_state;
+
+	//cached render of the static board layer (floor tiles + plain counters),
+	// redrawn only when a new level is generated or when the drawable size changes:
+	struct {
+		GLuint program = -1U; //copies color+depth from the textures to the current framebuffer
+		GLuint empty_vao = -1U;
+
+		GLuint framebuffer = -1U;
+		GLuint color_tex = -1U;
+		GLuint depth_tex = -1U;
+		glm::uvec2 size = glm::uvec2(0, 0);
+		uint32_t level = -1U; //sim.level the cache was drawn for
+	} board_composite;
+
+	//------- profiling ------------
+
+	//per-scope CPU/GPU timings; main.cpp adds scopes for update, draw and swap:
+	// (owned by the render thread once it starts; update's time arrives in each FramePacket)
+	Profiler profiler;
+	bool show_profiler = false; //toggled with 'P'
+	bool profiler_shown = false; //render thread: whether the last frame drew the overlay (a legend is printed when it appears)
+
+	//bars for the profiler overlay are rebuilt every frame into this buffer:
+	GLuint profiler_bars_vbo = -1U;
+	GLuint profiler_bars_for_simple_shading_vao = -1U;
+	void draw_profiler();
+
 	//---- transformations -----
 	// NOTE: Based on discussion from https://solarianprogrammer.com/2013/05/22/opengl-101-matrices-projection-view-model/
     glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(0.5f, 0.5f, 0.5f));
@@ -86,20 +161,17 @@ struct Game {
 
     glm::mat4 scale_z = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 1.0f, 0.25f));
 
-    //------- sound ------------
-    // NOTE: Based on code from https://gist.github.com/armornick/3447121
+	//------- jobs ------------
+
+	//work-stealing pool for engine tasks (sounds are loaded and levels prefetched through it); the thread that makes the Game
+	// (main.cpp's) counts as one of its workers, and helps out whenever it waits on a Jobs::Counter:
+	Jobs jobs;
 
-    struct Sound {
-        uint32_t wav_length;
-        uint8_t *wav_buffer;
-        SDL_AudioSpec wav_spec;
-    };
+	//------- sound ------------
 
-    Sound d0;
-    Sound re;
-    Sound mi;
-    Sound fa;
-    Sound so;
+	//every note plays through one audio device, opened in the constructor and fed by the mixer:
+	Mixer mixer;
+	SDL_AudioDeviceID audio_device = 0;
 
     //------- text ------------
 
@@ -118,57 +190,27 @@ struct Game {
 
 	//------- game state -------
 
-	// avatar movement
-	// NOTE: Based on discussion from http://www.cplusplus.com/forum/general/29835/
-	const float max_velocity = 0.15f;
-    const float acceleration = 0.75f;
-    const float deceleration = 0.75f;
-
-    glm::vec3 avatar_location = glm::vec3(4,4,0);
-    glm::quat avatar_rotation = glm::quat();
-	float x_velocity = 0.0f; // tiles per second
-    float y_velocity = 0.0f;
-
-    struct {
-        float go_left = false;
-        float go_right = false;
-        float go_up = false;
-        float go_down = false;
-    } controls;
-
-    // board info
-    glm::uvec2 board_size = glm::uvec2(9,9);
-
-	struct Edge {
-	    uint8_t is_row = 0;
-	    uint8_t is_end = 0;
-	};
-    Edge top;
-    Edge bottom;
-    Edge left;
-    Edge right;
-	std::set<Edge *> edges;
-
-	struct CounterInfo{
-        Mesh *active;
-        Mesh *inactive;
-	    glm::uvec3 location = glm::uvec3(0,0,0);
-	    glm::quat rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(-90.0f)));
-	};
-	CounterInfo peanut;
-	CounterInfo bread;
-	CounterInfo jelly;
-	CounterInfo serve;
-    std::vector< CounterInfo * >key_counters;
+	//avatar, board and progression (no GL or SDL inside):
+	Simulation sim;
 
-    // level progression
-	uint8_t next_pickup = 0;
-	uint32_t num_sandwiches = 0;
+	//makes sim's next level as a job on 'jobs' while the current one is played:
+	LevelPrefetch level_prefetch;
 
-	std::vector< Sound * > notes;
-	std::vector< CounterInfo * > level_progression;
+	//if set, a bot drives sim.controls every update (main.cpp's --bot):
+	bool bot = false;
+	BotFields bot_fields;
 
-    //------- additional functions ------------
+	//avatar pose as of the start of the latest update step (draw interpolates from here):
+	glm::vec3 previous_avatar_location = sim.avatar_location;
+	glm::quat previous_avatar_rotation = sim.avatar_rotation;
+
+	//meshes for each of sim.counters (same order):
+	struct CounterMeshes {
+		Mesh *active;
+		Mesh *inactive;
+	};
+	std::vector< CounterMeshes > key_counter_meshes;
 
-    void generate_level();  //randomizes board
+	//mixer sound ids of the notes played for each step of sim.level_progression:
+	std::vector< uint32_t > notes;
 };
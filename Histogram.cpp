@@ -0,0 +1,101 @@
+#include "Histogram.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+Histogram::Histogram() {
+	for (auto &b : buckets) b.store(0, std::memory_order_relaxed);
+}
+
+uint32_t Histogram::bucket(uint64_t ns) {
+	if (ns < 2 * SubCount) return uint32_t(ns);
+	//position of the highest set bit (at least SubBits + 1 here), by binary search:
+	uint32_t msb = 0;
+	for (uint32_t step = 32; step > 0; step /= 2) {
+		if (ns >> (msb + step)) msb += step;
+	}
+	uint32_t shift = msb - SubBits;
+	return 2 * SubCount + (shift - 1) * SubCount + uint32_t(ns >> shift) - SubCount;
+}
+
+uint64_t Histogram::bucket_top(uint32_t index) {
+	if (index < 2 * SubCount) return index;
+	uint32_t shift = (index - 2 * SubCount) / SubCount + 1;
+	uint64_t sub = (index - 2 * SubCount) % SubCount + SubCount;
+	return ((sub + 1) << shift) - 1;
+}
+
+Histogram::Summary Histogram::summarize() const {
+	Summary summary;
+	//(counted from the buckets themselves, so the percentiles agree with the count)
+	std::vector< uint64_t > counts(Buckets);
+	for (uint32_t i = 0; i < Buckets; ++i) {
+		counts[i] = buckets[i].load(std::memory_order_relaxed);
+		summary.count += counts[i];
+		if (counts[i]) summary.buckets.emplace_back(bucket_top(i), counts[i]);
+	}
+	summary.max_ns = max_ns.load(std::memory_order_relaxed);
+	if (summary.count == 0) return summary;
+	summary.mean_ns = double(total_ns.load(std::memory_order_relaxed)) / summary.count;
+
+	auto percentile = [&](double p) -> uint64_t {
+		uint64_t rank = uint64_t(p * summary.count);
+		if (rank >= summary.count) rank = summary.count - 1;
+		uint64_t seen = 0;
+		for (uint32_t i = 0; i < Buckets; ++i) {
+			seen += counts[i];
+			if (seen > rank) return std::min(bucket_top(i), summary.max_ns);
+		}
+		return summary.max_ns;
+	};
+	summary.p50_ns = percentile(0.50);
+	summary.p95_ns = percentile(0.95);
+	summary.p99_ns = percentile(0.99);
+	return summary;
+}
+
+void write_table(HistogramReport const &report, std::ostream *out_) {
+	std::ostream &out = *out_;
+	std::ios::fmtflags flags = out.flags();
+	out << std::fixed << std::setprecision(3);
+	out << "  " << std::left << std::setw(10) << "phase" << std::right << std::setw(9) << "count"
+		<< std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p95"
+		<< std::setw(10) << "p99" << std::setw(10) << "max" << "  (ms)" << std::endl;
+	for (auto const &entry : report) {
+		Histogram::Summary const &s = entry.second;
+		out << "  " << std::left << std::setw(10) << entry.first << std::right << std::setw(9) << s.count
+			<< std::setw(10) << s.mean_ns / 1.0e6 << std::setw(10) << s.p50_ns / 1.0e6 << std::setw(10) << s.p95_ns / 1.0e6
+			<< std::setw(10) << s.p99_ns / 1.0e6 << std::setw(10) << s.max_ns / 1.0e6 << std::endl;
+	}
+	out.flags(flags);
+}
+
+void write_csv(HistogramReport const &report, std::ostream *out_) {
+	std::ostream &out = *out_;
+	out << "phase,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+	for (auto const &entry : report) {
+		Histogram::Summary const &s = entry.second;
+		out << entry.first << ',' << s.count << ',' << s.mean_ns / 1.0e6 << ',' << s.p50_ns / 1.0e6 << ','
+			<< s.p95_ns / 1.0e6 << ',' << s.p99_ns / 1.0e6 << ',' << s.max_ns / 1.0e6 << '\n';
+	}
+}
+
+void write_json(HistogramReport const &report, std::ostream *out_) {
+	std::ostream &out = *out_;
+	//(phase names are plain identifiers, so nothing needs escaping)
+	out << "{\n";
+	for (uint32_t i = 0; i < report.size(); ++i) {
+		Histogram::Summary const &s = report[i].second;
+		out << "\t\"" << report[i].first << "\": {\"count\": " << s.count << ", \"mean_ms\": " << s.mean_ns / 1.0e6
+			<< ", \"p50_ms\": " << s.p50_ns / 1.0e6 << ", \"p95_ms\": " << s.p95_ns / 1.0e6
+			<< ", \"p99_ms\": " << s.p99_ns / 1.0e6 << ", \"max_ms\": " << s.max_ns / 1.0e6 << ",\n";
+		//non-empty buckets as [upper bound in ms, count] pairs, for plotting the whole distribution:
+		out << "\t\t\"buckets\": [";
+		for (uint32_t b = 0; b < s.buckets.size(); ++b) {
+			out << (b ? ", " : "") << '[' << s.buckets[b].first / 1.0e6 << ", " << s.buckets[b].second << ']';
+		}
+		out << "]}" << (i + 1 < report.size() ? "," : "") << "\n";
+	}
+	out << "}\n";
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// A 'Histogram' counts durations (in nanoseconds) in log-linear buckets, like
+// an HDR histogram: values below 64 get a bucket each, and every power of two
+// above that is split into 32 buckets, so any recorded value is known to
+// within about 3% however large it is, in fixed storage (~15k per histogram).
+//
+// record() is a few relaxed atomic adds and never allocates or locks, so one
+// thread can record while another reads percentiles; readers see each bucket
+// exactly, though a snapshot taken mid-record may be missing the latest value.
+//   Histogram update_ns;
+//   update_ns.record(ns); ... update_ns.summarize().p99;
+
+struct Histogram {
+	enum : uint32_t {
+		SubBits = 5,
+		SubCount = 1 << SubBits, //buckets per power of two
+		Buckets = 2 * SubCount + (64 - SubBits - 1) * SubCount,
+	};
+
+	Histogram();
+	Histogram(Histogram const &) = delete;
+
+	void record(uint64_t ns) {
+		buckets[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+		total_ns.fetch_add(ns, std::memory_order_relaxed);
+		uint64_t seen = max_ns.load(std::memory_order_relaxed);
+		while (ns > seen && !max_ns.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) { }
+	}
+
+	//which bucket 'ns' falls in, and the largest value that bucket holds:
+	static uint32_t bucket(uint64_t ns);
+	static uint64_t bucket_top(uint32_t index);
+
+	//the recorded distribution at the time of the call:
+	struct Summary {
+		uint64_t count = 0;
+		double mean_ns = 0.0;
+		uint64_t p50_ns = 0, p95_ns = 0, p99_ns = 0; //(each the top of its bucket, so never under the true value)
+		uint64_t max_ns = 0; //(exact)
+		std::vector< std::pair< uint64_t, uint64_t > > buckets; //non-empty buckets: (top, count), in order
+	};
+	Summary summarize() const;
+
+	//------ internals ------
+	std::atomic< uint64_t > buckets[Buckets];
+	std::atomic< uint64_t > total_ns{0};
+	std::atomic< uint64_t > max_ns{0};
+};
+
+//write named summaries as a table (milliseconds, for people), as CSV, or as JSON (both for dashboards):
+typedef std::vector< std::pair< std::string, Histogram::Summary > > HistogramReport;
+void write_table(HistogramReport const &report, std::ostream *out);
+void write_csv(HistogramReport const &report, std::ostream *out);
+void write_json(HistogramReport const &report, std::ostream *out);
@@ -0,0 +1,231 @@
+#include "Jobs.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+//the pool (if any) the calling thread belongs to, and its worker index there:
+static thread_local Jobs const *current_pool = nullptr;
+static thread_local uint32_t current_index = -1U;
+
+//------ Deque ------
+// (every access to top/bottom is sequentially consistent, which gives the
+//  store-load ordering take() and steal() need without standalone fences)
+
+bool Jobs::Deque::push(Job *job) {
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= Capacity) return false;
+	slots[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	bottom.store(b + 1); //(publishes the job to thieves)
+	return true;
+}
+
+Jobs::Job *Jobs::Deque::take() {
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b);
+	int64_t t = top.load();
+	if (t > b) { //empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	Job *job = slots[b & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (t == b) {
+		//last job: race any thief for it:
+		if (!top.compare_exchange_strong(t, t + 1)) job = nullptr;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Jobs::Job *Jobs::Deque::steal() {
+	int64_t t = top.load();
+	int64_t b = bottom.load();
+	if (t >= b) return nullptr;
+	Job *job = slots[t & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1)) return nullptr; //(lost to the owner or another thief)
+	return job;
+}
+
+//------ Jobs ------
+
+Jobs::Jobs(uint32_t count) {
+	if (count == -1U) {
+		count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	}
+	for (uint32_t i = 0; i <= count; ++i) {
+		workers.emplace_back(new Worker);
+	}
+	if (current_pool == nullptr) {
+		current_pool = this;
+		current_index = 0;
+	}
+	for (uint32_t i = 1; i <= count; ++i) {
+		workers[i]->thread = std::thread([this, i]() {
+			current_pool = this;
+			current_index = i;
+			work(i);
+		});
+	}
+}
+
+Jobs::~Jobs() {
+	//finish everything (including jobs still held by run_after):
+	while (outstanding.load() > 0) {
+		Job *job = find(worker_index());
+		if (job) execute(job, worker_index());
+		else std::this_thread::yield();
+	}
+	{
+		std::lock_guard< std::mutex > lock(sleep_mutex);
+		quit.store(true);
+	}
+	wake.notify_all();
+	for (auto &worker : workers) {
+		if (worker->thread.joinable()) worker->thread.join();
+	}
+	if (current_pool == this) {
+		current_pool = nullptr;
+		current_index = -1U;
+	}
+}
+
+uint32_t Jobs::worker_index() const {
+	return (current_pool == this ? current_index : -1U);
+}
+
+void Jobs::run(char const *name, std::function< void() > task, Counter *done) {
+	Job *job = new Job{ std::move(task), name, done };
+	if (done) done->pending.fetch_add(1);
+	outstanding.fetch_add(1);
+	push(job);
+}
+
+void Jobs::run_after(Counter *dependency, char const *name, std::function< void() > task, Counter *done) {
+	assert(dependency && dependency != done);
+	Job *job = new Job{ std::move(task), name, done };
+	if (done) done->pending.fetch_add(1);
+	outstanding.fetch_add(1);
+	{
+		//(execute counts down and releases the waiting list under the same lock)
+		std::lock_guard< std::mutex > lock(dependency->mutex);
+		if (dependency->pending.load() != 0) {
+			dependency->waiting.emplace_back(job);
+			return;
+		}
+	}
+	push(job);
+}
+
+void Jobs::wait(Counter *counter) {
+	uint32_t index = worker_index();
+	while (counter->pending.load(std::memory_order_acquire) > 0) {
+		Job *job = find(index);
+		if (job) execute(job, index);
+		else std::this_thread::yield();
+	}
+	std::exception_ptr error;
+	{
+		std::lock_guard< std::mutex > lock(counter->mutex);
+		std::swap(error, counter->error);
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+void Jobs::push(Job *job) {
+	uint32_t index = worker_index();
+	if (index == -1U || !workers[index]->deque.push(job)) {
+		std::lock_guard< std::mutex > lock(injected_mutex);
+		injected.emplace_back(job);
+		injected_count.fetch_add(1);
+	}
+	queued.fetch_add(1);
+	//(a worker going to sleep bumps 'sleepers' before checking 'queued', so one of the two sees the other)
+	if (sleepers.load() > 0) {
+		std::lock_guard< std::mutex > lock(sleep_mutex);
+		wake.notify_one();
+	}
+}
+
+Jobs::Job *Jobs::find(uint32_t index) {
+	Job *job = nullptr;
+	//own deque first (newest first, while its data is still in cache):
+	if (index != -1U) job = workers[index]->deque.take();
+	//then anything submitted from outside:
+	if (!job && injected_count.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard< std::mutex > lock(injected_mutex);
+		if (!injected.empty()) {
+			job = injected.back();
+			injected.pop_back();
+			injected_count.fetch_sub(1);
+		}
+	}
+	//then steal (oldest first) from the others, starting with the next worker over:
+	if (!job) {
+		uint32_t count = uint32_t(workers.size());
+		uint32_t start = (index == -1U ? 0 : index + 1);
+		for (uint32_t i = 0; i < count && !job; ++i) {
+			uint32_t victim = (start + i) % count;
+			if (victim == index) continue;
+			job = workers[victim]->deque.steal();
+		}
+		if (job && index != -1U) workers[index]->stolen.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (job) queued.fetch_sub(1);
+	return job;
+}
+
+void Jobs::execute(Job *job, uint32_t index) {
+	Counter *done = job->done;
+	std::exception_ptr error;
+	try {
+		if (hook) {
+			Clock::time_point begin = Clock::now();
+			job->task();
+			hook(hook_user, job->name, index, begin, Clock::now());
+		} else {
+			job->task();
+		}
+	} catch (...) {
+		//(like an exception escaping a std::thread, there is nowhere to report it without a counter)
+		if (!done) std::terminate();
+		error = std::current_exception();
+	}
+	if (index != -1U) workers[index]->executed.fetch_add(1, std::memory_order_relaxed);
+	delete job;
+
+	if (done) {
+		//count down under the counter's lock, so run_after sees either a pending job or an empty
+		// waiting list, and wait can't return (and the counter go away) while it's still in use here:
+		std::vector< Job * > released;
+		{
+			std::lock_guard< std::mutex > lock(done->mutex);
+			if (error && !done->error) done->error = error;
+			if (done->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) std::swap(released, done->waiting);
+		}
+		for (Job *waiting : released) push(waiting);
+	}
+	outstanding.fetch_sub(1);
+}
+
+void Jobs::work(uint32_t index) {
+	const uint32_t SpinsBeforeSleep = 64;
+	uint32_t idle = 0;
+	while (true) {
+		Job *job = find(index);
+		if (job) {
+			execute(job, index);
+			idle = 0;
+			continue;
+		}
+		if (++idle < SpinsBeforeSleep) {
+			std::this_thread::yield();
+			continue;
+		}
+		idle = 0;
+		std::unique_lock< std::mutex > lock(sleep_mutex);
+		sleepers.fetch_add(1);
+		wake.wait(lock, [this]() { return queued.load() > 0 || quit.load(); });
+		sleepers.fetch_sub(1);
+		if (quit.load() && queued.load() == 0) break;
+	}
+}
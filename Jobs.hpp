@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 'Jobs' is a work-stealing thread pool for engine tasks (loading, level
+// generation, transform building, ...).
+//
+// Every worker -- and the thread that made the pool, which counts as worker 0
+// and runs jobs while it waits -- has its own deque: it pushes and takes jobs
+// at one end without contention, and idle workers steal from the other end of
+// someone else's. Threads outside the pool submit through a shared (locked)
+// queue instead. Workers with nothing to run or steal go to sleep.
+//
+// Completion is tracked with Counters: a job submitted with a Counter holds it
+// up until the job finishes, wait(&counter) helps run jobs until it drops to
+// zero (then re-throws the first exception any of them threw), and
+// run_after(&counter, ...) holds a job back until it does.
+//   Jobs jobs;
+//   Jobs::Counter level, transforms;
+//   jobs.run("make_level", [&](){ ... }, &level);
+//   jobs.run_after(&level, "transforms", [&](){ ... }, &transforms);
+//   jobs.wait(&transforms);
+
+struct Jobs {
+	typedef std::chrono::steady_clock Clock;
+	struct Job;
+
+	struct Counter {
+		Counter() = default;
+		Counter(Counter const &) = delete;
+
+		std::atomic< uint32_t > pending{0}; //jobs submitted with this counter that haven't finished
+
+		//------ internals (guarded by mutex) ------
+		std::mutex mutex;
+		std::vector< Job * > waiting; //jobs submitted with run_after(this)
+		std::exception_ptr error;
+	};
+
+	//start 'workers' threads besides the calling one (-1U: one per core, less the caller's):
+	explicit Jobs(uint32_t workers = -1U);
+	//runs everything still queued, then stops the workers:
+	~Jobs();
+	Jobs(Jobs const &) = delete;
+
+	//queue 'task' ('name' is a string literal reported to the hook); 'done' (if given) is held up until it finishes.
+	// Tasks without a counter must not throw:
+	void run(char const *name, std::function< void() > task, Counter *done = nullptr);
+
+	//the same, but 'task' is only queued once 'dependency' has no pending jobs:
+	void run_after(Counter *dependency, char const *name, std::function< void() > task, Counter *done = nullptr);
+
+	//run jobs until 'counter' has no pending jobs; re-throws the first exception a job with it threw:
+	void wait(Counter *counter);
+
+	//number of threads that run jobs (workers plus the owner):
+	uint32_t threads() const { return uint32_t(workers.size()); }
+
+	//------ profiling ------
+
+	//if set (before submitting work), called on the worker after every job with when it ran:
+	typedef void (*Hook)(void *user, char const *name, uint32_t worker, Clock::time_point begin, Clock::time_point end);
+	Hook hook = nullptr;
+	void *hook_user = nullptr;
+
+	//------ internals ------
+
+	struct Job {
+		std::function< void() > task;
+		char const *name;
+		Counter *done;
+	};
+
+	//Chase-Lev deque (fixed capacity): the owner pushes and takes at the bottom, thieves steal from the top:
+	struct Deque {
+		enum : int64_t { Capacity = 4096 };
+		bool push(Job *job); //owner only; false if full
+		Job *take(); //owner only
+		Job *steal(); //any thread
+		std::atomic< int64_t > top{0}, bottom{0};
+		std::atomic< Job * > slots[Capacity];
+	};
+
+	struct Worker {
+		Deque deque;
+		std::thread thread; //(not started for worker 0, the owner)
+		std::atomic< uint64_t > executed{0}; //jobs run by this worker
+		std::atomic< uint64_t > stolen{0}; //...of which it stole from another
+	};
+	std::vector< std::unique_ptr< Worker > > workers;
+
+	//jobs from threads outside the pool (and overflow from full deques):
+	std::mutex injected_mutex;
+	std::vector< Job * > injected;
+	std::atomic< uint32_t > injected_count{0};
+
+	std::atomic< uint32_t > queued{0}; //jobs in deques or 'injected' (sleeping workers wake when this is non-zero)
+	std::atomic< uint32_t > outstanding{0}; //jobs submitted and not yet finished (including ones held by run_after)
+
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	std::atomic< uint32_t > sleepers{0};
+	std::atomic< bool > quit{false};
+
+	uint32_t worker_index() const; //of the calling thread, or -1U if it isn't part of this pool
+	void push(Job *job);
+	Job *find(uint32_t index);
+	void execute(Job *job, uint32_t index);
+	void work(uint32_t index);
+};
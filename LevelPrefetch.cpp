@@ -0,0 +1,47 @@
+#include "LevelPrefetch.hpp"
+
+LevelPrefetch::LevelPrefetch(Jobs &jobs_) : jobs(jobs_) {
+}
+
+LevelPrefetch::~LevelPrefetch() {
+	if (running) {
+		try {
+			jobs.wait(&done);
+		} catch (std::exception &) {
+			//(nobody is left to want the level)
+		}
+	}
+}
+
+void LevelPrefetch::wait() {
+	if (!running) return;
+	try {
+		jobs.wait(&done); //(the level itself is collected by the next update)
+	} catch (std::exception &) {
+		running = false; //(...unless make_level threw, in which case there is nothing to collect)
+		throw;
+	}
+}
+
+void LevelPrefetch::update(Simulation *sim) {
+	//collect finished work:
+	if (running && done.pending.load(std::memory_order_acquire) == 0) {
+		running = false;
+		jobs.wait(&done); //(doesn't block; re-throws anything make_level threw)
+		//(if the simulation already moved past that level -- e.g. it was restored from a snapshot -- the result is dropped)
+		if (pending_level == sim->level && !sim->next_level_ready) {
+			sim->next_level = level;
+			sim->next_level_ready = true;
+		}
+	}
+
+	//start on the level after this one:
+	if (!running && !sim->next_level_ready && pending_level != sim->level) {
+		Simulation copy = *sim;
+		jobs.run("make_level", [this, copy]() {
+			level = copy.make_next_level();
+		}, &done);
+		running = true;
+		pending_level = sim->level;
+	}
+}
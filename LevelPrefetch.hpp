@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Simulation.hpp"
+#include "Jobs.hpp"
+
+#include <cstdint>
+
+// 'LevelPrefetch' makes a Simulation's next level as a job on a Jobs pool while
+// the current one is being played, so that finishing a sandwich doesn't stall
+// the frame that calls generate_level.
+//
+// Call update(&sim) before each sim.update: it submits make_level as soon as a
+// new level begins and, once the job is done, hands the result to the
+// simulation (sim.next_level). It never blocks. Levels depend only on the
+// simulation's seed and state at the start of the level, so the result is the
+// same whether or not the prefetch finished in time (and recordings replay
+// identically).
+
+struct LevelPrefetch {
+	explicit LevelPrefetch(Jobs &jobs);
+	//waits for a running job (it writes into this object):
+	~LevelPrefetch();
+	LevelPrefetch(LevelPrefetch const &) = delete;
+
+	void update(Simulation *sim);
+
+	//is a job still making a level?
+	bool busy() const { return running && done.pending.load(std::memory_order_acquire) != 0; }
+	//help the pool until the running job (if any) is done; the next update() collects its level:
+	void wait();
+
+	Jobs &jobs;
+	Jobs::Counter done; //held up by the running job
+	bool running = false; //a job was submitted and its level not yet collected
+	Simulation::Level level; //written by the job
+	uint32_t pending_level = -1U; //sim.level that 'level' follows
+};
@@ -0,0 +1,283 @@
+#include "Mixer.hpp"
+#include "AudioStream.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIXER_SSE2
+#endif
+
+uint32_t Mixer::add_sound(std::vector< int16_t > &&samples) {
+	sounds.emplace_back();
+	Sound &sound = sounds.back();
+	sound.samples = std::move(samples);
+	sound.frames = uint32_t(sound.samples.size() / 2);
+	return uint32_t(sounds.size() - 1);
+}
+
+char const *Mixer::kernel_name() {
+#if defined(__AVX2__)
+	return "avx2";
+#elif defined(MIXER_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+uint32_t Mixer::add_adpcm(std::vector< uint8_t > &&blocks, uint32_t frames) {
+	assert(blocks.size() >= (frames + Adpcm::BlockFrames - 1) / Adpcm::BlockFrames * Adpcm::BlockBytes);
+	sounds.emplace_back();
+	Sound &sound = sounds.back();
+	sound.adpcm = std::move(blocks);
+	sound.frames = frames;
+	return uint32_t(sounds.size() - 1);
+}
+
+uint32_t Mixer::add_stream(AudioStream *stream) {
+	assert(stream);
+	sounds.emplace_back();
+	sounds.back().stream = stream;
+	return uint32_t(sounds.size() - 1);
+}
+
+Mixer::Handle Mixer::play(uint32_t sound, float volume, float pan) {
+	assert(sound < sounds.size());
+	pan = std::max(-1.0f, std::min(1.0f, pan));
+	Command command;
+	command.type = Command::Play;
+	command.handle = next_handle;
+	command.sound = sound;
+	//centered sounds play at full volume on both sides; panning fades out the far side:
+	command.left = volume * std::min(1.0f, 1.0f - pan);
+	command.right = volume * std::min(1.0f, 1.0f + pan);
+	if (!commands.push(command)) {
+		++dropped;
+		return 0;
+	}
+	++next_handle;
+	if (next_handle == 0) next_handle = 1;
+	return command.handle;
+}
+
+void Mixer::stop(Handle handle) {
+	if (handle == 0) return;
+	Command command;
+	command.type = Command::Stop;
+	command.handle = handle;
+	if (!commands.push(command)) ++dropped;
+}
+
+bool Mixer::playing(Handle handle) const {
+	if (handle == 0) return false;
+	//still waiting in the queue:
+	if (int32_t(handle - started.load(std::memory_order_acquire)) > 0) return true;
+	for (auto const &h : voice_handles) {
+		if (h.load(std::memory_order_relaxed) == handle) return true;
+	}
+	return false;
+}
+
+void Mixer::apply_commands() {
+	//apply queued commands in order; new sounds go on a free voice or else on the one that has played longest:
+	Command command;
+	while (commands.pop(&command)) {
+		if (command.type == Command::Stop) {
+			for (uint32_t i = 0; i < MaxVoices; ++i) {
+				if (voices[i].active && voice_handles[i].load(std::memory_order_relaxed) == command.handle) {
+					voices[i].active = false;
+					voice_handles[i].store(0, std::memory_order_relaxed);
+				}
+			}
+			continue;
+		}
+
+		//(streams are long by nature, so they are only replaced if every voice is a stream)
+		auto age = [this](Voice const &v) -> uint32_t {
+			return sounds[v.sound].stream ? 0 : v.position + 1;
+		};
+		uint32_t slot = 0;
+		for (uint32_t i = 0; i < MaxVoices; ++i) {
+			if (!voices[i].active) {
+				slot = i;
+				break;
+			}
+			if (age(voices[i]) > age(voices[slot])) slot = i;
+		}
+		Voice &voice = voices[slot];
+		if (voice.active) stolen.fetch_add(1, std::memory_order_relaxed);
+		voice.active = true;
+		voice.sound = command.sound;
+		voice.position = 0;
+		//(a stream played before starts over from the top of its file)
+		if (sounds[command.sound].stream) sounds[command.sound].stream->restart();
+		voice.left = command.left;
+		voice.right = command.right;
+		voice_handles[slot].store(command.handle, std::memory_order_relaxed);
+		//(release: a reader that sees this handle as started also sees the voice it went to)
+		started.store(command.handle, std::memory_order_release);
+	}
+}
+
+//sum[i] += src[i] * gain, with the gain alternating left/right ('samples' is even):
+static void accumulate_scalar(float *sum, int16_t const *src, uint32_t samples, float left, float right) {
+	for (uint32_t i = 0; i < samples; i += 2) {
+		sum[i] += float(src[i]) * left;
+		sum[i+1] += float(src[i+1]) * right;
+	}
+}
+
+//out[i] = sum[i] clamped to 16 bits and rounded to nearest (even):
+static void saturate_scalar(int16_t *out, float const *sum, uint32_t samples) {
+	for (uint32_t i = 0; i < samples; ++i) {
+		out[i] = int16_t(std::lrint(std::min(std::max(sum[i], -32768.0f), 32767.0f)));
+	}
+}
+
+#if defined(__AVX2__)
+static void accumulate(float *sum, int16_t const *src, uint32_t samples, float left, float right) {
+	__m256 gain = _mm256_setr_ps(left, right, left, right, left, right, left, right);
+	uint32_t i = 0;
+	for (; i + 16 <= samples; i += 16) {
+		__m128i lo = _mm_loadu_si128(reinterpret_cast< __m128i const * >(src + i));
+		__m128i hi = _mm_loadu_si128(reinterpret_cast< __m128i const * >(src + i + 8));
+		__m256 a = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(lo));
+		__m256 b = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(hi));
+		_mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), _mm256_mul_ps(a, gain)));
+		_mm256_storeu_ps(sum + i + 8, _mm256_add_ps(_mm256_loadu_ps(sum + i + 8), _mm256_mul_ps(b, gain)));
+	}
+	accumulate_scalar(sum + i, src + i, samples - i, left, right);
+}
+
+static void saturate(int16_t *out, float const *sum, uint32_t samples) {
+	const __m256 lo = _mm256_set1_ps(-32768.0f);
+	const __m256 hi = _mm256_set1_ps(32767.0f);
+	uint32_t i = 0;
+	for (; i + 16 <= samples; i += 16) {
+		__m256i a = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(sum + i), lo), hi));
+		__m256i b = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(sum + i + 8), lo), hi));
+		//(packs works within 128-bit lanes, so put the 64-bit quarters back in order)
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+		_mm256_storeu_si256(reinterpret_cast< __m256i * >(out + i), packed);
+	}
+	saturate_scalar(out + i, sum + i, samples - i);
+}
+#elif defined(MIXER_SSE2)
+static void accumulate(float *sum, int16_t const *src, uint32_t samples, float left, float right) {
+	__m128 gain = _mm_setr_ps(left, right, left, right);
+	uint32_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		__m128i s = _mm_loadu_si128(reinterpret_cast< __m128i const * >(src + i));
+		//sign-extend to 32 bits by unpacking each sample into the high half:
+		__m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+		__m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+		_mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(a, gain)));
+		_mm_storeu_ps(sum + i + 4, _mm_add_ps(_mm_loadu_ps(sum + i + 4), _mm_mul_ps(b, gain)));
+	}
+	accumulate_scalar(sum + i, src + i, samples - i, left, right);
+}
+
+static void saturate(int16_t *out, float const *sum, uint32_t samples) {
+	const __m128 lo = _mm_set1_ps(-32768.0f);
+	const __m128 hi = _mm_set1_ps(32767.0f);
+	uint32_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(sum + i), lo), hi));
+		__m128i b = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(sum + i + 4), lo), hi));
+		_mm_storeu_si128(reinterpret_cast< __m128i * >(out + i), _mm_packs_epi32(a, b));
+	}
+	saturate_scalar(out + i, sum + i, samples - i);
+}
+#else
+static void accumulate(float *sum, int16_t const *src, uint32_t samples, float left, float right) {
+	accumulate_scalar(sum, src, samples, left, right);
+}
+
+static void saturate(int16_t *out, float const *sum, uint32_t samples) {
+	saturate_scalar(out, sum, samples);
+}
+#endif
+
+void Mixer::mix(int16_t *out, uint32_t frames) {
+	apply_commands();
+	mix_voices(out, frames, true);
+}
+
+void Mixer::mix_scalar(int16_t *out, uint32_t frames) {
+	apply_commands();
+	mix_voices(out, frames, false);
+}
+
+void Mixer::mix_voices(int16_t *out, uint32_t frames, bool vectorized) {
+	//sum voices in blocks small enough to stay in cache, then saturate each block to 16 bits:
+	float sum[2 * Block];
+	while (frames > 0) {
+		uint32_t count = std::min(frames, uint32_t(Block));
+		std::fill(sum, sum + 2 * count, 0.0f);
+
+		//decode every ADPCM voice's share of the block at once (see Adpcm.hpp):
+		if (vectorized) {
+			Adpcm::Stream streams[MaxVoices];
+			uint32_t stream_count = 0;
+			for (Voice &v : voices) {
+				if (!v.active || sounds[v.sound].adpcm.empty()) continue;
+				Sound const &sound = sounds[v.sound];
+				Adpcm::Stream &stream = streams[stream_count++];
+				stream.blocks = sound.adpcm.data();
+				stream.first = v.position;
+				stream.count = std::min(count, sound.frames - v.position);
+				stream.state = v.adpcm;
+				stream.out = decoded[&v - voices];
+			}
+			Adpcm::decode(streams, stream_count);
+		}
+
+		for (Voice &v : voices) {
+			if (!v.active) continue;
+			Sound const &sound = sounds[v.sound];
+			uint32_t n;
+			int16_t const *src;
+			bool ended;
+			int16_t unpacked[2 * Block];
+			if (sound.stream) {
+				//take whatever the reader has ready; a shortfall before the end is an underrun (heard as a gap),
+				// unless the stream is still rewinding for a replay:
+				bool restarting = sound.stream->restarting();
+				n = sound.stream->read(unpacked, count);
+				src = unpacked;
+				ended = (n < count && sound.stream->finished());
+				if (n < count && !ended && !restarting) underruns.fetch_add(1, std::memory_order_relaxed);
+			} else if (!sound.adpcm.empty()) {
+				n = std::min(count, sound.frames - v.position);
+				if (vectorized) {
+					src = decoded[&v - voices];
+				} else {
+					Adpcm::decode(sound.adpcm.data(), v.position, n, v.adpcm, unpacked);
+					src = unpacked;
+				}
+				ended = (v.position + n == sound.frames);
+			} else {
+				n = std::min(count, sound.frames - v.position);
+				src = &sound.samples[2 * v.position];
+				ended = (v.position + n == sound.frames);
+			}
+			if (vectorized) accumulate(sum, src, 2 * n, v.left, v.right);
+			else accumulate_scalar(sum, src, 2 * n, v.left, v.right);
+			v.position += n;
+			if (ended) {
+				v.active = false;
+				voice_handles[&v - voices].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		if (vectorized) saturate(out, sum, 2 * count);
+		else saturate_scalar(out, sum, 2 * count);
+		out += 2 * count;
+		frames -= count;
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "SPSCQueue.hpp"
+#include "Adpcm.hpp"
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+struct AudioStream;
+
+// The 'Mixer' plays any number of sounds at once through a single, always-open
+// audio device. It owns a fixed pool of voices; the game thread asks for
+// sounds with play(), which only enqueues a command, and the audio thread
+// calls mix() to start queued sounds and sum every active voice into the
+// device buffer. Neither side takes a lock, so a note starts within one
+// device buffer of being requested.
+//
+// Ownership: voices belong to the audio thread alone. The game thread only
+// ever talks to them through the command queue (play/stop, applied in order
+// at the start of the next mix) and reads back what the audio thread
+// publishes in atomics (which handle each voice is playing), so there is no
+// shared mutable state without synchronization. See audio-stress.cpp for a
+// stress test of this handoff.
+//
+// Voices are summed in 32-bit float with a separate left/right gain each
+// (volume and pan), then clamped and rounded to 16 bits in a single pass over
+// the output. Both loops run 4 (SSE2) or 8 (AVX2) samples at a time, with a
+// scalar fallback that produces identical output (see mix-bench.cpp).
+//
+// Sounds are interleaved stereo 16-bit samples at the device's rate; they are
+// added (and converted, see Game.cpp) before the device starts. They can also
+// be held as IMA-ADPCM at a quarter of the size and decoded while mixing, four
+// voices at a time (add_adpcm), or, if long, streamed from disk (add_stream).
+// Nothing here depends on SDL, so mix() can also be driven without a device.
+
+struct Mixer {
+	enum { MaxVoices = 32, QueueLength = 256 };
+
+	Mixer() : commands(QueueLength) {
+		for (auto &h : voice_handles) h.store(0, std::memory_order_relaxed);
+	}
+
+	//add a sound (interleaved stereo frames); returns its id for play().
+	//All sounds must be added before mix() is first called:
+	uint32_t add_sound(std::vector< int16_t > &&samples);
+
+	//add an IMA-ADPCM sound of 'frames' stereo frames (blocks as in Adpcm.hpp), kept compressed and
+	// decoded as it plays; returns its id for play():
+	uint32_t add_adpcm(std::vector< uint8_t > &&blocks, uint32_t frames);
+
+	//add a sound that is read from disk as it plays (see AudioStream.hpp); returns its id for play().
+	//The stream must outlive the mixer's use of it:
+	uint32_t add_stream(AudioStream *stream);
+
+	//------- game thread -------
+
+	//identifies one play() request (0 = none):
+	typedef uint32_t Handle;
+
+	//start 'sound' at 'volume' (1 = unchanged), panned by 'pan' (-1 = left only, 0 = centered, 1 = right only);
+	// if every voice is busy the one that has played longest is replaced.
+	//Returns 0 if the command queue was full (the note is dropped):
+	Handle play(uint32_t sound, float volume = 1.0f, float pan = 0.0f);
+
+	//stop a sound early (no effect if it already finished):
+	void stop(Handle handle);
+
+	//true from play() until the sound finishes, is stopped, or has its voice taken:
+	bool playing(Handle handle) const;
+
+	//------- audio thread -------
+
+	//write 'frames' stereo frames to 'out' (uses the widest kernel this build was compiled for):
+	void mix(int16_t *out, uint32_t frames);
+
+	//the same, one sample at a time (reference for the SIMD kernels and for benchmarks):
+	void mix_scalar(int16_t *out, uint32_t frames);
+
+	//name of the kernel mix() uses ("avx2", "sse2", or "scalar"):
+	static char const *kernel_name();
+
+	//------- state -------
+
+	struct Sound {
+		std::vector< int16_t > samples; //interleaved stereo
+		uint32_t frames = 0;
+		std::vector< uint8_t > adpcm; //if not empty, samples are decoded from here instead
+		AudioStream *stream = nullptr; //if set, samples come from here instead
+	};
+	std::vector< Sound > sounds;
+
+	struct Command {
+		enum : uint8_t { Play = 0, Stop = 1 };
+		uint8_t type = Play;
+		Handle handle = 0;
+		uint32_t sound = 0;
+		float left = 1.0f, right = 1.0f; //gains
+	};
+	SPSCQueue< Command > commands;
+
+	//game thread only:
+	Handle next_handle = 1;
+	uint32_t dropped = 0; //commands lost to a full queue
+
+	//written by the audio thread, readable from any thread:
+	std::atomic< Handle > voice_handles[MaxVoices]; //handle playing on each voice (0 = idle)
+	std::atomic< Handle > started{0}; //last handle taken off the queue (handles are issued in order)
+	std::atomic< uint32_t > stolen{0}; //voices cut short to make room for new sounds
+	std::atomic< uint32_t > underruns{0}; //blocks a stream wasn't ready for
+
+	//audio thread only:
+	struct Voice {
+		bool active = false;
+		uint32_t sound = 0;
+		uint32_t position = 0; //frames played so far
+		float left = 0.0f, right = 0.0f; //gains
+		Adpcm::State adpcm[2]; //decoder state, for ADPCM sounds
+	};
+	Voice voices[MaxVoices];
+
+	//mix_voices works through the output this many frames at a time:
+	enum { Block = 256 };
+	//ADPCM voices' samples for the current block, decoded together (by mix(); mix_scalar decodes each voice as it goes):
+	int16_t decoded[MaxVoices][2 * Block];
+
+	//start/stop voices as the queued commands say, then mix (shared by mix and mix_scalar):
+	void apply_commands();
+	void mix_voices(int16_t *out, uint32_t frames, bool vectorized);
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// 'PCG32' is a small, fast random number generator (M.E. O'Neill's pcg32,
+// XSH-RR output) with 64 bits of state.
+// Unlike rand(), its output depends only on the seed, so a given seed produces
+// the same sequence on every platform, build and run.
+
+struct PCG32 {
+	PCG32(uint64_t seed = 0, uint64_t stream = 0x14057b7ef767814fULL) {
+		inc = (stream << 1) | 1u;
+		state = 0;
+		next();
+		state += seed;
+		next();
+	}
+
+	//next 32 random bits:
+	uint32_t next() {
+		uint64_t old = state;
+		state = old * 6364136223846793005ULL + inc;
+		uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+		uint32_t rot = uint32_t(old >> 59u);
+		return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+	}
+
+	//uniformly distributed in [0, bound) without modulo bias (bound must be > 0):
+	uint32_t below(uint32_t bound) {
+		uint32_t threshold = (0u - bound) % bound;
+		while (true) {
+			uint32_t r = next();
+			if (r >= threshold) return r % bound;
+		}
+	}
+
+	uint64_t state = 0;
+	uint64_t inc = 0;
+};
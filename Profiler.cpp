@@ -0,0 +1,120 @@
+#include "Profiler.hpp"
+
+#include <cassert>
+
+Profiler::~Profiler() {
+	for (Scope &s : scopes) {
+		if (s.gpu) {
+			glDeleteQueries(QueryRingLength, s.queries);
+		}
+	}
+	scopes.clear();
+}
+
+uint32_t Profiler::add_scope(std::string const &name, bool gpu) {
+	scopes.emplace_back();
+	Scope &s = scopes.back();
+	s.name = name;
+	s.gpu = gpu;
+	for (uint32_t i = 0; i < HistoryLength; ++i) {
+		s.cpu_ms[i] = 0.0f;
+		s.gpu_ms[i] = -1.0f;
+	}
+	for (uint32_t i = 0; i < QueryRingLength; ++i) {
+		s.queries[i] = 0;
+		s.query_frame[i] = -1U;
+	}
+	if (gpu) {
+		glGenQueries(QueryRingLength, s.queries);
+	}
+	return uint32_t(scopes.size() - 1);
+}
+
+void Profiler::begin_frame() {
+	++frame;
+	uint32_t slot = frame % HistoryLength;
+
+	for (Scope &s : scopes) {
+		assert(!s.query_active && "scopes should not be open across frames");
+		s.cpu_ms[slot] = 0.0f;
+		s.gpu_ms[slot] = -1.0f;
+		if (!s.gpu) continue;
+
+		//collect any queries that have finished, without blocking on those that haven't:
+		for (uint32_t i = 0; i < QueryRingLength; ++i) {
+			if (s.query_frame[i] == -1U) continue;
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(s.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == GL_FALSE) continue;
+
+			//NOTE: 32-bit nanosecond result (good for ~4 seconds), since glGetQueryObjectui64v isn't in the 3.2-era shims:
+			GLuint elapsed_ns = 0;
+			glGetQueryObjectuiv(s.queries[i], GL_QUERY_RESULT, &elapsed_ns);
+			//only record if the history slot hasn't been recycled yet:
+			if (frame - s.query_frame[i] < HistoryLength) {
+				s.gpu_ms[s.query_frame[i] % HistoryLength] = elapsed_ns / 1.0e6f;
+			}
+			s.query_frame[i] = -1U;
+		}
+	}
+}
+
+void Profiler::begin(uint32_t scope) {
+	assert(scope < scopes.size());
+	Scope &s = scopes[scope];
+	s.cpu_begin = std::chrono::high_resolution_clock::now();
+
+	if (s.gpu) {
+		//one query per scope per frame; if the ring slot is still waiting on an old result, skip GPU timing this frame:
+		uint32_t ring = frame % QueryRingLength;
+		if (s.query_frame[ring] == -1U) {
+			glBeginQuery(GL_TIME_ELAPSED, s.queries[ring]);
+			s.query_frame[ring] = frame;
+			s.query_active = true;
+		}
+	}
+}
+
+void Profiler::end(uint32_t scope) {
+	assert(scope < scopes.size());
+	Scope &s = scopes[scope];
+
+	if (s.query_active) {
+		glEndQuery(GL_TIME_ELAPSED);
+		s.query_active = false;
+	}
+
+	auto now = std::chrono::high_resolution_clock::now();
+	s.cpu_ms[frame % HistoryLength] += std::chrono::duration< float, std::milli >(now - s.cpu_begin).count();
+}
+
+void Profiler::add_cpu_ms(uint32_t scope, float ms) {
+	assert(scope < scopes.size());
+	scopes[scope].cpu_ms[frame % HistoryLength] += ms;
+}
+
+float Profiler::average_cpu_ms(uint32_t scope) const {
+	assert(scope < scopes.size());
+	Scope const &s = scopes[scope];
+	uint32_t count = (frame < HistoryLength ? frame : uint32_t(HistoryLength));
+	if (count == 0) return 0.0f;
+	float total = 0.0f;
+	for (uint32_t i = 0; i < count; ++i) {
+		total += s.cpu_ms[(frame - i) % HistoryLength];
+	}
+	return total / count;
+}
+
+float Profiler::average_gpu_ms(uint32_t scope) const {
+	assert(scope < scopes.size());
+	Scope const &s = scopes[scope];
+	float total = 0.0f;
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < HistoryLength; ++i) {
+		if (s.gpu_ms[i] >= 0.0f) {
+			total += s.gpu_ms[i];
+			++count;
+		}
+	}
+	return (count ? total / count : 0.0f);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The 'Profiler' struct keeps a rolling per-frame history of how long named
+// scopes take, both on the CPU (std::chrono) and -- for scopes that issue GL
+// work -- on the GPU (GL_TIME_ELAPSED queries).
+//
+// GPU results are never waited on: each scope owns a small ring of query
+// objects, and results are collected a few frames later once the GL reports
+// them as available.
+
+struct Profiler {
+	//number of frames of history kept for each scope:
+	enum : uint32_t { HistoryLength = 120 };
+	//number of frames a GPU query may stay in flight before its slot is reused:
+	enum : uint32_t { QueryRingLength = 4 };
+
+	//Profiler creates query objects in add_scope and frees them in its
+	//destructor, so it must live while a GL context is current.
+	Profiler() = default;
+	~Profiler();
+
+	//add_scope registers a named scope and returns its index.
+	// 'gpu' scopes are also timed with GL_TIME_ELAPSED queries; since those
+	// queries cannot overlap, gpu scopes must not nest inside each other.
+	uint32_t add_scope(std::string const &name, bool gpu);
+
+	//begin_frame should be called once at the start of every drawn frame (on the render thread);
+	// it advances the history and collects any finished GPU queries:
+	void begin_frame();
+
+	//begin/end bracket one use of a scope (a scope may be used several times per frame; times add up):
+	void begin(uint32_t scope);
+	void end(uint32_t scope);
+
+	//convenience wrapper that calls begin/end for the lifetime of a block:
+	struct Marker {
+		Marker(Profiler &profiler_, uint32_t scope_) : profiler(profiler_), scope(scope_) {
+			profiler.begin(scope);
+		}
+		~Marker() {
+			profiler.end(scope);
+		}
+		Profiler &profiler;
+		uint32_t scope;
+	};
+
+	//add_cpu_ms adds time measured elsewhere (e.g. on another thread) to a scope's current frame:
+	void add_cpu_ms(uint32_t scope, float ms);
+
+	//------- recorded data -------
+
+	struct Scope {
+		std::string name;
+		bool gpu = false;
+
+		//timings (in milliseconds) indexed by frame % HistoryLength;
+		// gpu_ms is negative for frames whose GPU time is not (yet) known:
+		float cpu_ms[HistoryLength];
+		float gpu_ms[HistoryLength];
+
+		std::chrono::high_resolution_clock::time_point cpu_begin;
+
+		//ring of GL_TIME_ELAPSED queries; query_frame is the frame a query was
+		//issued in, or -1U if the slot is free:
+		GLuint queries[QueryRingLength];
+		uint32_t query_frame[QueryRingLength];
+		bool query_active = false;
+	};
+	std::vector< Scope > scopes;
+
+	//index of the current frame (history slot is frame % HistoryLength):
+	uint32_t frame = 0;
+
+	//average over the recorded history (ignoring unknown GPU times):
+	float average_cpu_ms(uint32_t scope) const;
+	float average_gpu_ms(uint32_t scope) const;
+};
@@ -0,0 +1,100 @@
+#include "Recording.hpp"
+
+#include "read_chunk.hpp"
+#include "write_chunk.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+
+namespace {
+	//first chunk of a recording file
+	// (version 2: levels come from CounterPlacement, so version 1 seeds replay differently;
+	//  version 3: each level draws from its own PCG32(seed, index) stream and later levels keep
+	//  a wider berth around the avatar, so version 2 seeds replay differently too):
+	struct Header {
+		uint32_t version = 3;
+		uint32_t flags = 0; //combination of the bits below
+		enum : uint32_t { Bot = 1 };
+		uint64_t seed = 0;
+	};
+	static_assert(sizeof(Header) == 16, "Header should be packed.");
+}
+
+bool Recording::add_event(SDL_Event const &evt) {
+	Event event;
+	if (evt.type == SDL_KEYDOWN || evt.type == SDL_KEYUP) {
+		event.type = (evt.type == SDL_KEYDOWN ? Event::KeyDown : Event::KeyUp);
+		event.repeat = evt.key.repeat;
+		event.scancode = uint16_t(evt.key.keysym.scancode);
+	} else if (evt.type == SDL_QUIT) {
+		event.type = Event::Quit;
+	} else {
+		return false;
+	}
+	events.emplace_back(event);
+	++pending_events;
+	return true;
+}
+
+void Recording::add_frame(float elapsed) {
+	Frame frame;
+	frame.elapsed = elapsed;
+	frame.events = pending_events;
+	frames.emplace_back(frame);
+	pending_events = 0;
+}
+
+SDL_Event Recording::to_sdl(Event const &event) {
+	SDL_Event evt;
+	std::memset(&evt, 0, sizeof(evt));
+	if (event.type == Event::Quit) {
+		evt.type = SDL_QUIT;
+	} else {
+		evt.type = (event.type == Event::KeyDown ? SDL_KEYDOWN : SDL_KEYUP);
+		evt.key.repeat = event.repeat;
+		evt.key.keysym.scancode = SDL_Scancode(event.scancode);
+	}
+	return evt;
+}
+
+void Recording::save(std::string const &filename) const {
+	std::ofstream out(filename, std::ios::binary);
+	if (!out) {
+		throw std::runtime_error("Failed to open '" + filename + "' for writing.");
+	}
+	Header header;
+	header.seed = seed;
+	header.flags = (bot ? Header::Bot : 0);
+	write_chunk("rec0", std::vector< Header >(1, header), &out);
+	write_chunk("frm0", frames, &out);
+	write_chunk("evt0", events, &out);
+	if (!out) {
+		throw std::runtime_error("Failed to write recording to '" + filename + "'.");
+	}
+}
+
+void Recording::load(std::string const &filename) {
+	std::ifstream in(filename, std::ios::binary);
+	if (!in) {
+		throw std::runtime_error("Failed to open recording '" + filename + "'.");
+	}
+	std::vector< Header > header;
+	read_chunk(in, "rec0", &header);
+	if (header.size() != 1 || header[0].version != Header().version) {
+		throw std::runtime_error("Unsupported recording header in '" + filename + "'.");
+	}
+	seed = header[0].seed;
+	bot = (header[0].flags & Header::Bot) != 0;
+	read_chunk(in, "frm0", &frames);
+	read_chunk(in, "evt0", &events);
+
+	uint64_t total = 0;
+	for (Frame const &f : frames) {
+		total += f.events;
+	}
+	if (total != events.size()) {
+		throw std::runtime_error("Recording '" + filename + "' has mismatched frame and event counts.");
+	}
+	pending_events = 0;
+}
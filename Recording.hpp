@@ -0,0 +1,51 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The 'Recording' struct holds everything needed to play a session back
+// exactly: the level seed, whether a bot was playing, the elapsed time of
+// every main loop pass, and the input events the game handled during each pass.
+//
+// On disk it is a sequence of chunks (see read_chunk.hpp / write_chunk.hpp).
+
+struct Recording {
+	uint64_t seed = 0;
+	bool bot = false; //session was played by a bot (main.cpp's --bot)
+
+	//one entry per pass through the main loop:
+	struct Frame {
+		float elapsed = 0.0f; //seconds of wall-clock time fed to the simulation
+		uint32_t events = 0; //number of entries of 'events' handled before this frame's update
+	};
+	static_assert(sizeof(Frame) == 8, "Frame should be packed.");
+	std::vector< Frame > frames;
+
+	//compact form of an input event:
+	struct Event {
+		enum : uint8_t { KeyDown = 0, KeyUp = 1, Quit = 2 };
+		uint8_t type = KeyDown;
+		uint8_t repeat = 0;
+		uint16_t scancode = 0;
+	};
+	static_assert(sizeof(Event) == 4, "Event should be packed.");
+	std::vector< Event > events;
+
+	//append an event handled this frame; returns false (and records nothing) for event types that aren't recorded:
+	bool add_event(SDL_Event const &evt);
+	//append the frame's elapsed time, closing off the events added since the previous frame:
+	void add_frame(float elapsed);
+
+	//expand a recorded event back into an SDL_Event:
+	static SDL_Event to_sdl(Event const &event);
+
+	//file I/O; both throw on failure:
+	void save(std::string const &filename) const;
+	void load(std::string const &filename);
+
+	//events added since the last add_frame:
+	uint32_t pending_events = 0;
+};
@@ -0,0 +1,104 @@
+#include "Resampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+//zeroth-order modified Bessel function of the first kind (for the Kaiser window):
+static double bessel_i0(double x) {
+	double sum = 1.0, term = 1.0;
+	for (uint32_t k = 1; k < 50; ++k) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12) break;
+	}
+	return sum;
+}
+
+Resampler::Resampler(uint32_t from_rate_, uint32_t to_rate_) : from_rate(from_rate_), to_rate(to_rate_) {
+	if (from_rate == 0 || to_rate == 0) {
+		throw std::runtime_error("Resampler needs non-zero sample rates.");
+	}
+	if (from_rate == to_rate) return; //(resample just copies)
+
+	const double Pi = 3.14159265358979323846;
+	const double Beta = 8.6; //Kaiser window shape; trades transition width for stopband depth
+	const uint32_t ZeroCrossings = 16; //on each side of the filter's center
+	const uint32_t MaxPhases = 4096;
+
+	uint32_t a = from_rate, b = to_rate;
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	phases = std::min(to_rate / a, MaxPhases);
+
+	//cutoff, in cycles per input sample; below the output's Nyquist frequency when downsampling:
+	double cutoff = 0.5 * std::min(1.0, double(to_rate) / double(from_rate)) * 0.97;
+	double half_width = ZeroCrossings / (2.0 * cutoff); //in input samples
+	uint32_t reach = uint32_t(std::ceil(half_width));
+	taps = 2 * reach;
+
+	table.resize(phases * taps);
+	double window_scale = 1.0 / bessel_i0(Beta);
+	for (uint32_t p = 0; p < phases; ++p) {
+		double frac = double(p) / phases;
+		float *coefficients = &table[p * taps];
+		double total = 0.0;
+		for (uint32_t k = 0; k < taps; ++k) {
+			//distance from the output position to input sample (index + 1 - reach + k):
+			double x = frac + double(reach) - 1.0 - double(k);
+			double r = x / half_width;
+			double h = 0.0;
+			if (std::abs(r) < 1.0) {
+				double arg = 2.0 * cutoff * x;
+				double sinc = (arg == 0.0 ? 1.0 : std::sin(Pi * arg) / (Pi * arg));
+				h = 2.0 * cutoff * sinc * bessel_i0(Beta * std::sqrt(1.0 - r * r)) * window_scale;
+			}
+			coefficients[k] = float(h);
+			total += h;
+		}
+		//unity gain at DC for every phase (otherwise constant input picks up a ripple):
+		for (uint32_t k = 0; k < taps; ++k) {
+			coefficients[k] = float(coefficients[k] / total);
+		}
+	}
+}
+
+uint32_t Resampler::output_frames(uint32_t frames) const {
+	return uint32_t((uint64_t(frames) * to_rate + from_rate - 1) / from_rate);
+}
+
+std::vector< float > Resampler::resample(float const *in, uint32_t frames, uint32_t channels) const {
+	if (from_rate == to_rate) {
+		return std::vector< float >(in, in + size_t(frames) * channels);
+	}
+
+	uint32_t out_frames = output_frames(frames);
+	std::vector< float > out(size_t(out_frames) * channels, 0.0f);
+	int64_t reach = taps / 2;
+	for (uint32_t j = 0; j < out_frames; ++j) {
+		//output frame j sits at input position j * from_rate / to_rate:
+		uint64_t position = uint64_t(j) * from_rate;
+		int64_t index = int64_t(position / to_rate);
+		uint64_t phase = ((position % to_rate) * phases + to_rate / 2) / to_rate;
+		if (phase == phases) {
+			phase = 0;
+			index += 1;
+		}
+		float const *coefficients = &table[phase * taps];
+
+		int64_t first = index + 1 - reach;
+		int64_t k_begin = std::max< int64_t >(0, -first);
+		int64_t k_end = std::min< int64_t >(taps, int64_t(frames) - first);
+		for (uint32_t c = 0; c < channels; ++c) {
+			float sum = 0.0f;
+			for (int64_t k = k_begin; k < k_end; ++k) {
+				sum += coefficients[k] * in[size_t(first + k) * channels + c];
+			}
+			out[size_t(j) * channels + c] = sum;
+		}
+	}
+	return out;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// 'Resampler' converts interleaved float audio from one sample rate to another
+// with a Kaiser-windowed sinc filter (about 90dB of stopband attenuation, with
+// the passband running to ~97% of the lower rate's Nyquist frequency).
+//
+// The filter is tabulated once per rate pair as a polyphase bank: one set of
+// taps for every fractional position an output sample can fall on (exact when
+// the rates have a reasonable common divisor, e.g. 44100 <-> 48000; quantized
+// to 4096 positions otherwise). It is meant for converting sounds at load time,
+// not for running in the audio callback.
+
+struct Resampler {
+	Resampler(uint32_t from_rate, uint32_t to_rate);
+
+	//resample 'frames' frames of 'channels'-channel interleaved audio
+	// (samples before the start and past the end are taken as silence):
+	std::vector< float > resample(float const *in, uint32_t frames, uint32_t channels) const;
+
+	//number of output frames for 'frames' input frames:
+	uint32_t output_frames(uint32_t frames) const;
+
+	uint32_t from_rate, to_rate;
+	uint32_t phases = 1; //fractional positions tabulated
+	uint32_t taps = 1; //filter length per phase
+	std::vector< float > table; //phases * taps coefficients (tap k of phase p is table[p * taps + k])
+};
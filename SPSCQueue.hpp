@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+// 'SPSCQueue' is a fixed-capacity, lock-free queue for exactly one producer
+// thread and one consumer thread (e.g. the game thread sending commands to
+// the audio callback). Neither side ever blocks or allocates after
+// construction; push fails when the queue is full.
+
+template< typename T >
+struct SPSCQueue {
+	//capacity is rounded up to a power of two:
+	explicit SPSCQueue(uint32_t capacity) {
+		uint32_t size = 1;
+		while (size < capacity) size *= 2;
+		slots.resize(size);
+		mask = size - 1;
+	}
+
+	//producer side; returns false (and drops 'value') if the queue is full:
+	bool push(T const &value) {
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) > mask) return false;
+		slots[t & mask] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	//consumer side; returns false if the queue is empty:
+	bool pop(T *value) {
+		assert(value);
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+		*value = slots[h & mask];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	//producer side, in bulk; pushes as many of 'count' values as fit and returns how many that was:
+	uint32_t push(T const *values, uint32_t count) {
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		uint32_t space = (mask + 1) - (t - head.load(std::memory_order_acquire));
+		count = std::min(count, space);
+		//(in at most two runs, split where the ring wraps)
+		uint32_t run = std::min(count, (mask + 1) - (t & mask));
+		std::copy(values, values + run, slots.begin() + (t & mask));
+		std::copy(values + run, values + count, slots.begin());
+		tail.store(t + count, std::memory_order_release);
+		return count;
+	}
+
+	//consumer side, in bulk; pops up to 'count' values and returns how many there were:
+	uint32_t pop(T *values, uint32_t count) {
+		assert(values || count == 0);
+		uint32_t h = head.load(std::memory_order_relaxed);
+		count = std::min(count, tail.load(std::memory_order_acquire) - h);
+		uint32_t run = std::min(count, (mask + 1) - (h & mask));
+		std::copy(slots.begin() + (h & mask), slots.begin() + (h & mask) + run, values);
+		std::copy(slots.begin(), slots.begin() + (count - run), values + run);
+		head.store(h + count, std::memory_order_release);
+		return count;
+	}
+
+	//number of queued entries (exact only when called from one of the two threads while the other is idle):
+	uint32_t size() const {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+	std::vector< T > slots;
+	uint32_t mask = 0;
+
+	//head (next to pop) and tail (next to push) only ever increase; they are kept on
+	// separate cache lines so the two threads don't contend for one line:
+	char pad0[64];
+	std::atomic< uint32_t > head{0};
+	char pad1[64];
+	std::atomic< uint32_t > tail{0};
+	char pad2[64];
+};
@@ -0,0 +1,172 @@
+#include "Simulation.hpp"
+#include "SpatialGrid.hpp"
+#include "CounterPlacement.hpp"
+#include "PCG32.hpp"
+
+#include <vector>
+#include <stdexcept>
+#include <cstring>
+#include <cassert>
+
+// avatar movement
+// NOTE: Based on discussion from http://www.cplusplus.com/forum/general/29835/
+// (tuned to match the original once-per-60Hz-frame movement)
+const float Simulation::max_velocity = 9.0f; // tiles per second
+const float Simulation::acceleration = 45.0f; // tiles per second^2
+const float Simulation::deceleration = 45.0f;
+
+Simulation::Simulation(uint64_t seed_) : seed(seed_) {
+	generate_level();
+}
+
+Simulation::Level Simulation::make_level(uint64_t seed, uint32_t index, glm::uvec2 board_size, glm::vec2 avoid, float avoid_leeway) {
+	//each level has its own random stream, so levels can be generated in any order (or ahead of time):
+	PCG32 rng(seed, index);
+
+	//scatter as many counters as fit around the edge (kept clear of 'avoid' and of each other)
+	// and pick the key counters from among them:
+	std::vector< glm::uvec2 > spots;
+	CounterPlacement placement;
+	//(a maximal placement can still come up short on tiny boards, so try a few layouts)
+	for (uint32_t attempt = 0; attempt < 16 && spots.size() < CounterCount; ++attempt) {
+		spots.clear();
+		placement.place(board_size, 1.0f, -1U, &avoid, 1, avoid_leeway, rng, &spots);
+	}
+	if (spots.size() < CounterCount) {
+		throw std::runtime_error("Board is too small to place every key counter.");
+	}
+
+	Level ret;
+	for (uint32_t i = 0; i < CounterCount; ++i) {
+		//partial shuffle, so the key counters are a random subset of the spots:
+		std::swap(spots[i], spots[i + rng.below(uint32_t(spots.size()) - i)]);
+		glm::uvec2 spot = spots[i];
+
+		CounterInfo *counter = &ret.counters[i];
+		counter->location = glm::uvec3(spot.x, spot.y, 0);
+
+		// Rotate the serve counter to point outwards
+		if (i == Serve) {
+			float angle = 0.0f;
+			if (spot.y == 0) angle = 90.0f;
+			else if (spot.y == board_size.y - 1) angle = 270.0f;
+			else if (spot.x == board_size.x - 1) angle = 180.0f;
+			counter->rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(angle)));
+		}
+	}
+	return ret;
+}
+
+Simulation::Level Simulation::make_next_level() const {
+	if (level == 0) {
+		//first level: keep clear of the avatar's starting spot:
+		return make_level(seed, level, board_size, glm::vec2(avatar_location), 1.0f);
+	} else {
+		//later levels start wherever the avatar finished the last pickup -- somewhere within
+		// 0.5 + 1 tiles of the final counter -- so keep clear (leeway 1) of all of those spots:
+		glm::vec2 last = glm::vec2(counters[level_progression[progression_length - 1]].location);
+		return make_level(seed, level, board_size, last, 1.0f + 0.5f + 1.0f);
+	}
+}
+
+void Simulation::generate_level() {
+	if (next_level_ready) {
+		std::memcpy(counters, next_level.counters, sizeof(counters));
+		next_level_ready = false;
+	} else {
+		Level made = make_next_level();
+		std::memcpy(counters, made.counters, sizeof(counters));
+	}
+	++level;
+}
+
+bool Simulation::is_idle() const {
+	return !controls.go_left && !controls.go_right && !controls.go_up && !controls.go_down
+		&& x_velocity == 0.0f && y_velocity == 0.0f;
+}
+
+void Simulation::update(float elapsed) {
+	picked_up = -1;
+
+    // --------------- Progress -------------------------------
+    {
+    	CounterInfo const *next_counter = &counters[level_progression[next_pickup]];
+    	if (adjacent(glm::vec2(next_counter->location), glm::vec2(avatar_location), 0.5f)) {
+
+    		// (Game plays the matching note)
+    		picked_up = next_pickup;
+
+    		++next_pickup;
+    		if (next_pickup == progression_length) {
+	        	++num_sandwiches;
+	        	next_pickup = 0;
+	        	generate_level();
+    		}
+    	}
+    }
+
+	// --------------- Physics-based movement ---------------
+
+    // NOTE: Movement based on discussion from http://www.cplusplus.com/forum/general/29835/
+    // Default avatar orientation is (1,0);
+    {
+        if (controls.go_left) {
+            x_velocity -= elapsed * acceleration;
+            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(180.0f)));
+        }
+        if (controls.go_up) {
+            y_velocity += elapsed * acceleration;
+            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(90.0f)));
+        }
+        if (controls.go_right) {
+            x_velocity += elapsed * acceleration;
+            avatar_rotation = glm::quat();
+        }
+        if (controls.go_down) {
+            y_velocity -= elapsed * acceleration;
+            avatar_rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(-90.0f)));
+        }
+
+        // Decelerate to a stop
+        if (!controls.go_left && !controls.go_right && x_velocity != 0.0f) {
+        	int sign = x_velocity < 0 ? -1 : 1;
+            x_velocity -= sign * deceleration * elapsed;
+
+            if (sign > 0) {
+            	x_velocity = glm::clamp(x_velocity, 0.0f, max_velocity);
+            } else {
+            	x_velocity = glm::clamp(x_velocity, -max_velocity, 0.0f);
+            }
+        }
+        if (!controls.go_up && !controls.go_down && y_velocity != 0.0f) {
+			int sign = y_velocity < 0 ? -1 : 1;
+			y_velocity -= sign * deceleration * elapsed;
+
+			if (sign > 0) {
+				y_velocity = glm::clamp(y_velocity, 0.0f, max_velocity);
+			} else {
+				y_velocity = glm::clamp(y_velocity, -max_velocity, 0.0f);
+			}
+        }
+
+        x_velocity = glm::clamp(x_velocity, -max_velocity, max_velocity);
+        y_velocity = glm::clamp(y_velocity, -max_velocity, max_velocity);
+        assert(-max_velocity <= x_velocity && x_velocity <= max_velocity);
+        assert(-max_velocity <= y_velocity && y_velocity <= max_velocity);
+        glm::vec3 mv = x_velocity * glm::vec3(1.0f, 0.0f, 0.0f) + y_velocity * glm::vec3(0.0f, 1.0f, 0.0f);
+
+        if (mv != glm::vec3(0.0f, 0.0f, 0.0f)) {
+            avatar_location += mv * elapsed;
+            avatar_location.x = glm::clamp(avatar_location.x, 1.0f, (float) board_size.x - 2);
+            avatar_location.y = glm::clamp(avatar_location.y, 1.0f, (float) board_size.y - 2);
+
+            // Prevent avatar from "sticking" to counters
+            if (avatar_location.x == 1.0f || avatar_location.x == board_size.x - 2) {
+                x_velocity = 0.0f;
+            }
+            if (avatar_location.y == 1.0f || avatar_location.y == board_size.y - 2) {
+                y_velocity = 0.0f;
+            }
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <type_traits>
+#include <cstdint>
+
+// The 'Simulation' struct holds the game state and rules -- avatar movement,
+// level generation and pickup progression -- with no dependence on OpenGL or
+// SDL, so it can run headless (see sim-bench.cpp).
+// Game wraps it with input handling, rendering and audio.
+//
+// All state lives in fixed-size members and refers to counters by index, so a
+// Simulation is trivially copyable: a snapshot is a memcpy (see SnapshotRing.hpp).
+
+struct Simulation {
+	//'seed' determines the sequence of levels generated; the first level is generated here:
+	Simulation(uint64_t seed);
+
+	//advance by one step of 'elapsed' seconds:
+	void update(float elapsed);
+
+	//is_idle returns true if update would not change anything (no movement keys held, avatar at rest):
+	bool is_idle() const;
+
+	//------- avatar -------
+
+	//movement tuning (also used by the multi-agent kernels in Agents.cpp):
+	static const float max_velocity; // tiles per second
+	static const float acceleration; // tiles per second^2
+	static const float deceleration;
+
+	glm::vec3 avatar_location = glm::vec3(4,4,0);
+	glm::quat avatar_rotation = glm::quat();
+	float x_velocity = 0.0f; // tiles per second
+	float y_velocity = 0.0f;
+
+	struct {
+		bool go_left = false;
+		bool go_right = false;
+		bool go_up = false;
+		bool go_down = false;
+	} controls;
+
+	//------- board -------
+
+	glm::uvec2 board_size = glm::uvec2(9,9);
+
+	//key counters, one per ingredient/station:
+	enum : uint8_t { Peanut = 0, Bread = 1, Jelly = 2, Serve = 3, CounterCount = 4 };
+	struct CounterInfo {
+		glm::uvec3 location = glm::uvec3(0,0,0);
+		glm::quat rotation = glm::quat(glm::vec3(0.0f, 0.0f, glm::radians(-90.0f)));
+	};
+	CounterInfo counters[CounterCount];
+
+	//------- level progression -------
+
+	//indices into counters[], visited in order to make a sandwich:
+	enum : uint8_t { MaxProgression = 8 };
+	uint8_t level_progression[MaxProgression] = {Bread, Peanut, Jelly, Bread, Serve};
+	uint8_t progression_length = 5;
+
+	uint8_t next_pickup = 0;
+	uint32_t num_sandwiches = 0;
+
+	//number of levels generated so far (changes whenever the counter layout does):
+	uint32_t level = 0;
+
+	//if the last update completed a pickup, the progression index that was picked up; otherwise -1:
+	int32_t picked_up = -1;
+
+	//------- level generation -------
+
+	//all level randomness comes from this (level i draws from PCG32(seed, i)):
+	uint64_t seed = 0;
+
+	//the counter layout of a level:
+	struct Level {
+		CounterInfo counters[CounterCount];
+	};
+
+	//lay out level 'index' with counters kept clear of adjacent(counter, avoid, avoid_leeway)
+	// (depends only on its arguments, so it is safe to call from any thread):
+	static Level make_level(uint64_t seed, uint32_t index, glm::uvec2 board_size, glm::vec2 avoid, float avoid_leeway);
+
+	//the level generate_level will produce next; it is known as soon as the current level
+	// starts, so it can be made ahead of time (see LevelPrefetch.hpp):
+	Level make_next_level() const;
+
+	//if set, generate_level uses next_level instead of calling make_next_level:
+	Level next_level;
+	bool next_level_ready = false;
+
+	void generate_level(); //moves on to the next level's layout
+};
+
+static_assert(std::is_trivially_copyable< Simulation >::value, "Simulation snapshots rely on memcpy.");
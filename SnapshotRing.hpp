@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+
+// A 'SnapshotRing' keeps the most recent N copies of a trivially copyable
+// state struct (e.g. Simulation) in preallocated storage. Saving and restoring
+// are single memcpys; once full, the oldest snapshot is overwritten.
+//   SnapshotRing< Simulation > history(256);
+//   history.save(sim); ... history.restore(10, &sim); //rewind ten saves
+
+template< typename T >
+struct SnapshotRing {
+	static_assert(std::is_trivially_copyable< T >::value, "SnapshotRing copies with memcpy.");
+
+	explicit SnapshotRing(uint32_t capacity_) : slots(capacity_ * sizeof(T)), capacity(capacity_) {
+		assert(capacity > 0);
+	}
+
+	//copy 'state' into the ring as the newest snapshot:
+	void save(T const &state) {
+		std::memcpy(slot(head), &state, sizeof(T));
+		head = (head + 1) % capacity;
+		if (count < capacity) ++count;
+	}
+
+	//copy the snapshot taken 'age' saves ago (0 = newest) into '*state':
+	void restore(uint32_t age, T *state) const {
+		assert(state);
+		assert(age < count);
+		std::memcpy(state, slot((head + capacity - 1 - age) % capacity), sizeof(T));
+	}
+
+	//like restore, but also drops the snapshots newer than the one restored (so it becomes the newest):
+	void rewind(uint32_t age, T *state) {
+		restore(age, state);
+		head = (head + capacity - age) % capacity;
+		count -= age;
+	}
+
+	uint32_t size() const { return count; }
+	void clear() { head = 0; count = 0; }
+
+	//raw storage (kept as bytes so T need not be default constructible):
+	std::vector< unsigned char > slots;
+	uint32_t capacity = 0;
+	uint32_t head = 0; //slot the next save goes into
+	uint32_t count = 0; //number of valid snapshots
+
+	unsigned char *slot(uint32_t i) { return slots.data() + size_t(i) * sizeof(T); }
+	unsigned char const *slot(uint32_t i) const { return slots.data() + size_t(i) * sizeof(T); }
+};
@@ -0,0 +1,47 @@
+#include "SpatialGrid.hpp"
+
+void SpatialGrid::build(glm::uvec2 board_size, uint32_t count, float const *x, float const *y) {
+	size = board_size;
+	uint32_t cells = size.x * size.y;
+
+	//count points per cell (reusing storage between builds):
+	cell_start.assign(cells + 1, 0);
+	std::vector< uint32_t > &cell = scratch;
+	cell.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		cell[i] = cell_of(glm::vec2(x[i], y[i]));
+		++cell_start[cell[i] + 1];
+	}
+
+	//prefix sum to get where each cell's run starts:
+	for (uint32_t c = 0; c < cells; ++c) {
+		cell_start[c + 1] += cell_start[c];
+	}
+
+	//scatter (stable, so points within a cell stay in index order):
+	index.resize(count);
+	location.resize(count);
+	std::vector< uint32_t > &next = fill;
+	next.assign(cell_start.begin(), cell_start.end() - 1);
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t slot = next[cell[i]]++;
+		index[slot] = i;
+		location[slot] = glm::vec2(x[i], y[i]);
+	}
+}
+
+void SpatialGrid::query_adjacent(uint32_t count, float const *x, float const *y, float leeway,
+	std::vector< uint32_t > *hit_start_, std::vector< uint32_t > *hits_) const {
+	std::vector< uint32_t > &hit_start = *hit_start_;
+	std::vector< uint32_t > &hits = *hits_;
+
+	hit_start.resize(count + 1);
+	hits.clear();
+	for (uint32_t i = 0; i < count; ++i) {
+		hit_start[i] = uint32_t(hits.size());
+		for_each_adjacent(glm::vec2(x[i], y[i]), leeway, [&hits](uint32_t index) {
+			hits.emplace_back(index);
+		});
+	}
+	hit_start[count] = uint32_t(hits.size());
+}
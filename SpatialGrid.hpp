@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+// Positions on grid where locationB is adjacent to locationA with leeway of 0.0f:
+//          B B B
+//          B A B
+//          B B B
+// (locations are the lower-left corners of one-tile objects)
+inline bool adjacent(glm::vec2 locationA, glm::vec2 locationB, float leeway) {
+	float x_lo = locationA.x - 1.0f - leeway;
+	float x_hi = locationA.x + 2.0f + leeway;
+	float y_lo = locationA.y - 1.0f - leeway;
+	float y_hi = locationA.y + 2.0f + leeway;
+
+	return (locationB.x >= x_lo && locationB.x + 1.0f <= x_hi)
+	    && (locationB.y >= y_lo && locationB.y + 1.0f <= y_hi);
+}
+
+// A 'SpatialGrid' buckets points (counters, agents, ...) into the board's
+// one-tile cells so "what is adjacent to me" only looks at nearby cells
+// instead of every point. It is rebuilt from scratch with a counting sort,
+// which is linear in the number of points, so it is cheap to rebuild every
+// tick for moving points.
+//   grid.build(board_size, agents.count, agents.x.data(), agents.y.data());
+//   grid.for_each_adjacent(location, 0.5f, [&](uint32_t index){ ... });
+
+struct SpatialGrid {
+	//bucket 'count' points (x[i], y[i]) on a board of 'board_size' tiles
+	// (points off the board are clamped into the edge cells):
+	void build(glm::uvec2 board_size, uint32_t count, float const *x, float const *y);
+
+	//call 'fn(index)' for every point p with adjacent(p, location, leeway):
+	template< typename Fn >
+	void for_each_adjacent(glm::vec2 location, float leeway, Fn const &fn) const;
+
+	//batched form: for every query point i, the indices of adjacent points are appended to 'hits',
+	// with those for query i in [hit_start[i], hit_start[i+1]):
+	void query_adjacent(uint32_t count, float const *x, float const *y, float leeway,
+		std::vector< uint32_t > *hit_start, std::vector< uint32_t > *hits) const;
+
+	glm::uvec2 size = glm::uvec2(0, 0);
+
+	//points sorted by cell; cell c holds entries [cell_start[c], cell_start[c+1]):
+	std::vector< uint32_t > cell_start;
+	std::vector< uint32_t > index; //original index of each sorted point
+	std::vector< glm::vec2 > location; //location of each sorted point
+
+	//per-build working storage (kept to avoid reallocating every tick):
+	std::vector< uint32_t > scratch, fill;
+
+	uint32_t cell_of(glm::vec2 at) const {
+		return uint32_t(cell_coord(at.y, size.y)) * size.x + uint32_t(cell_coord(at.x, size.x));
+	}
+	static int32_t cell_coord(float v, uint32_t cells) {
+		int32_t c = int32_t(glm::floor(v));
+		return c < 0 ? 0 : (c >= int32_t(cells) ? int32_t(cells) - 1 : c);
+	}
+};
+
+template< typename Fn >
+void SpatialGrid::for_each_adjacent(glm::vec2 at, float leeway, Fn const &fn) const {
+	if (size.x == 0 || size.y == 0) return;
+	//adjacent points lie within 1 + leeway on each axis (plus a little, so rounding can't drop a cell):
+	float reach = 1.0f + leeway + 1.0e-3f;
+	int32_t x0 = cell_coord(at.x - reach, size.x), x1 = cell_coord(at.x + reach, size.x);
+	int32_t y0 = cell_coord(at.y - reach, size.y), y1 = cell_coord(at.y + reach, size.y);
+	for (int32_t cy = y0; cy <= y1; ++cy) {
+		//cells in a row are contiguous, so each row is one run of sorted points:
+		uint32_t begin = cell_start[cy * size.x + x0];
+		uint32_t end = cell_start[cy * size.x + x1 + 1];
+		for (uint32_t i = begin; i < end; ++i) {
+			if (adjacent(location[i], at, leeway)) fn(index[i]);
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// A 'TripleBuffer' hands the latest value of T from one writer thread to one
+// reader thread without locks. Each side owns one of the three slots outright;
+// the third sits in the middle and the two sides trade their slot for it with
+// a single atomic exchange, so neither ever waits on the other. The reader
+// always gets the newest published value; values it never got to are dropped.
+//   writer: buffer.write_slot() = value; buffer.publish();
+//   reader: if (buffer.acquire()) use(buffer.read_slot());
+
+template< typename T >
+struct TripleBuffer {
+	//----- writer -----
+
+	//the slot being filled (private to the writer until publish):
+	T &write_slot() { return slots[back]; }
+
+	//make write_slot the newest value and take the middle slot to write next:
+	void publish() {
+		back = middle.exchange(back | Fresh, std::memory_order_acq_rel) & Index;
+	}
+
+	//----- reader -----
+
+	//take the newest published value, if there is one the reader hasn't seen;
+	// returns false (leaving read_slot as it was) otherwise:
+	bool acquire() {
+		if (!(middle.load(std::memory_order_relaxed) & Fresh)) return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & Index;
+		return true;
+	}
+
+	//the value taken by the last successful acquire (private to the reader):
+	T const &read_slot() const { return slots[front]; }
+
+	//------ internals ------
+	enum : uint8_t { Index = 0x3, Fresh = 0x4 };
+
+	T slots[3];
+	uint8_t back = 0; //writer's slot
+	uint8_t front = 1; //reader's slot
+	std::atomic< uint8_t > middle{ 2 }; //index of the spare slot, plus Fresh if it holds a value the reader hasn't taken
+};
@@ -0,0 +1,211 @@
+//audio-latency measures, without an audio device, how long a note takes from
+// the update that asks for it to its first sample leaving the "device", and
+// how much of each device period the mixer uses.
+// Usage: audio-latency [--seconds <n>] [--games <n>] [--buffer <frames>] [--seed <n>]
+//
+// Bot-driven games step in real time at main.cpp's rate and play a note on
+// every pickup, as Game::update does, with each request timestamped. An
+// in-process sink stands in for the device: it calls Mixer::mix once per
+// buffer period, like SDL's audio thread calling audio_callback, and the buffer
+// it mixes is taken to start playing when the next period begins.
+// Notes are the packed game sounds (dist/sounds/*.adpcm) if they can be found.
+//
+// (To run the game itself without sound hardware, SDL's own dummy driver
+// works: SDL_AUDIODRIVER=dummy.)
+
+#include "Simulation.hpp"
+#include "Bots.hpp"
+#include "Mixer.hpp"
+#include "read_chunk.hpp"
+#include "data_path.hpp"
+#include "parse_unsigned.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+//p50/p95/p99/max of 'values' (sorted in place):
+static void print_percentiles(char const *name, std::vector< double > &values, char const *unit) {
+	std::cout << "  " << name << ": ";
+	if (values.empty()) {
+		std::cout << "(none)" << std::endl;
+		return;
+	}
+	std::sort(values.begin(), values.end());
+	auto at = [&](double p) {
+		return values[std::min(values.size() - 1, size_t(p * values.size()))];
+	};
+	std::cout << "p50 " << at(0.50) << unit << ", p95 " << at(0.95) << unit << ", p99 " << at(0.99) << unit
+		<< ", max " << values.back() << unit << " (" << values.size() << " samples)" << std::endl;
+}
+
+int main(int argc, char **argv) {
+	struct {
+		uint32_t seconds = 10;
+		uint32_t games = 64;
+		uint32_t buffer = 512; //same as Game.cpp's device buffer
+		uint64_t seed = 0;
+	} config;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		try {
+			if (arg == "--seconds" && argi + 1 < argc) {
+				config.seconds = parse_unsigned< uint32_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--games" && argi + 1 < argc) {
+				config.games = std::max(1u, parse_unsigned< uint32_t >(argv[argi + 1]));
+				argi += 1;
+			} else if (arg == "--buffer" && argi + 1 < argc) {
+				config.buffer = std::max(1u, parse_unsigned< uint32_t >(argv[argi + 1]));
+				argi += 1;
+			} else if (arg == "--seed" && argi + 1 < argc) {
+				config.seed = parse_unsigned< uint64_t >(argv[argi + 1]);
+				argi += 1;
+			} else {
+				std::cerr << "Usage:\n\t" << argv[0] << " [--seconds <n>] [--games <n>] [--buffer <frames>] [--seed <n>]" << std::endl;
+				return 1;
+			}
+		} catch (std::exception &) {
+			std::cerr << "Expecting a non-negative integer after " << arg << "." << std::endl;
+			return 1;
+		}
+	}
+
+	const uint32_t Rate = 44100;
+	const float SimulationStep = 1.0f / 120.0f; //same step main.cpp uses
+	const float Volume = 10.0f / 128.0f; //Game.cpp's AUDIO_VOLUME
+
+	Mixer mixer;
+	std::vector< uint32_t > notes;
+	struct Packed {
+		std::vector< uint8_t > blocks;
+		uint32_t frames;
+	};
+	std::vector< Packed > packed;
+	for (std::string name : { "fa (actually do)", "re", "mi", "do (actually fa)", "so" }) {
+		std::ifstream file(data_path("sounds/" + name + ".adpcm"), std::ios::binary);
+		if (!file) break;
+		std::vector< Adpcm::Header > header;
+		Packed note;
+		read_chunk(file, "adp0", &header);
+		read_chunk(file, "adb0", &note.blocks);
+		if (header.size() != 1 || header[0].rate != Rate) break;
+		note.frames = header[0].frames;
+		packed.emplace_back(std::move(note));
+	}
+	if (packed.size() == 5) {
+		for (Packed &note : packed) {
+			notes.emplace_back(mixer.add_adpcm(std::move(note.blocks), note.frames));
+		}
+	} else {
+		//stand-ins of about the same length: decaying tones a whole step apart:
+		std::cout << "(packed sounds not found; using generated tones)" << std::endl;
+		for (uint32_t n = 0; n < 5; ++n) {
+			double frequency = 523.25 * std::pow(2.0, n / 6.0);
+			std::vector< int16_t > samples(2 * 104517);
+			for (uint32_t i = 0; i < samples.size() / 2; ++i) {
+				double t = double(i) / Rate;
+				samples[2 * i] = samples[2 * i + 1] = int16_t(20000.0 * std::exp(-3.0 * t) * std::sin(2.0 * 3.14159265358979323846 * frequency * t));
+			}
+			notes.emplace_back(mixer.add_sound(std::move(samples)));
+		}
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	auto start = Clock::now();
+	auto seconds_since_start = [&](Clock::time_point t) {
+		return std::chrono::duration< double >(t - start).count();
+	};
+
+	//per-handle timestamps (seconds since start); the game thread writes 'requested', the sink the others:
+	const uint32_t MaxNotes = 1 << 20;
+	std::vector< double > requested(MaxNotes, 0.0), taken(MaxNotes, 0.0), heard(MaxNotes, 0.0);
+
+	//sink thread: one mix per buffer period, on a fixed schedule:
+	std::atomic< bool > done(false);
+	std::vector< double > callback_us;
+	std::thread sink([&]() {
+		std::vector< int16_t > out(2 * config.buffer);
+		auto period = std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(double(config.buffer) / Rate));
+		Mixer::Handle seen = 0;
+		auto tick = start;
+		while (!done.load(std::memory_order_relaxed)) {
+			std::this_thread::sleep_until(tick);
+			auto before = Clock::now();
+			mixer.mix(out.data(), config.buffer);
+			auto after = Clock::now();
+			callback_us.emplace_back(std::chrono::duration< double, std::micro >(after - before).count());
+
+			//notes started by this mix begin at the start of this buffer, which plays once the previous one has:
+			Mixer::Handle started = mixer.started.load(std::memory_order_acquire);
+			for (Mixer::Handle h = seen + 1; h <= started && h < MaxNotes; ++h) {
+				taken[h] = seconds_since_start(before);
+				heard[h] = seconds_since_start(tick + period);
+			}
+			seen = started;
+			tick += period;
+		}
+	});
+
+	//game thread (this one): bot-driven games, one fixed step per 1/120s, notes on pickup:
+	std::vector< Simulation > games;
+	std::vector< BotFields > fields(config.games);
+	games.reserve(config.games);
+	for (uint32_t g = 0; g < config.games; ++g) {
+		games.emplace_back(config.seed + g);
+	}
+	std::vector< double > update_us;
+	uint64_t dropped = 0;
+	auto step = std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(SimulationStep));
+	auto end = start + std::chrono::seconds(config.seconds);
+	for (auto tick = start; tick < end; tick += step) {
+		std::this_thread::sleep_until(tick);
+		auto before = Clock::now();
+		for (uint32_t g = 0; g < config.games; ++g) {
+			Simulation &sim = games[g];
+			fields[g].drive(&sim);
+			sim.update(SimulationStep);
+			if (sim.picked_up >= 0) {
+				Mixer::Handle next = mixer.next_handle;
+				if (next < MaxNotes) requested[next] = seconds_since_start(Clock::now());
+				if (mixer.play(notes[sim.picked_up], Volume) == 0) ++dropped;
+			}
+		}
+		update_us.emplace_back(std::chrono::duration< double, std::micro >(Clock::now() - before).count());
+	}
+
+	//let the last requests reach the sink:
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	done.store(true, std::memory_order_relaxed);
+	sink.join();
+
+	std::vector< double > to_callback, to_output;
+	for (Mixer::Handle h = 1; h < std::min< Mixer::Handle >(mixer.next_handle, MaxNotes); ++h) {
+		if (heard[h] == 0.0) continue;
+		to_callback.emplace_back(1000.0 * (taken[h] - requested[h]));
+		to_output.emplace_back(1000.0 * (heard[h] - requested[h]));
+	}
+
+	double period_us = 1.0e6 * config.buffer / Rate;
+	std::cout << config.games << " bot games for " << config.seconds << "s: " << to_output.size() << " notes ("
+		<< to_output.size() / double(config.seconds) << "/s), " << dropped << " dropped; "
+		<< config.buffer << "-frame buffers (" << period_us << "us)." << std::endl;
+	print_percentiles("request to callback", to_callback, "ms");
+	print_percentiles("request to first sample out", to_output, "ms");
+	print_percentiles("callback time", callback_us, "us");
+	if (!callback_us.empty()) {
+		std::cout << "    (p99 callback is " << 100.0 * callback_us[std::min(callback_us.size() - 1, size_t(0.99 * callback_us.size()))] / period_us
+			<< "% of the period)" << std::endl;
+	}
+	print_percentiles("update time (all games)", update_us, "us");
+
+	return 0;
+}
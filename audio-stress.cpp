@@ -0,0 +1,254 @@
+//audio-stress hammers the Mixer's game-thread/audio-thread handoff: one thread
+// plays, stops and queries notes as fast as it can while another mixes device
+// buffers on a real-time schedule, then checks that nothing was lost or torn.
+// Usage: audio-stress [--seconds <n>] [--rate <notes per second, 0 = unlimited>] [--buffer <frames>] [--seed <n>] [--stream-seconds <n>]
+//
+// Build with jam -sSANITIZE=thread to run it under ThreadSanitizer.
+//
+// Every test sound is a constant +1 sample, so each output sample is exactly
+// the number of voices sounding at that moment; anything outside [0, MaxVoices]
+// means a voice was read while the other thread was changing it.
+//
+// Afterward it streams a generated track (--stream-seconds long) through an
+// AudioStream at several times real-time speed and checks that every frame
+// arrives, in order, while the ring stays the same size; then that replaying
+// it, both after it ends and after a stop partway through, starts it over.
+
+#include "Mixer.hpp"
+#include "AudioStream.hpp"
+#include "PCG32.hpp"
+#include "write_chunk.hpp"
+#include "parse_unsigned.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+int main(int argc, char **argv) {
+	struct {
+		uint32_t seconds = 5;
+		uint32_t rate = 5000;
+		uint32_t buffer = 512; //same as Game.cpp's device buffer
+		uint64_t seed = 0;
+		uint32_t stream_seconds = 30;
+	} config;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		try {
+			if (arg == "--seconds" && argi + 1 < argc) {
+				config.seconds = parse_unsigned< uint32_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--rate" && argi + 1 < argc) {
+				config.rate = parse_unsigned< uint32_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--buffer" && argi + 1 < argc) {
+				config.buffer = std::max(1u, parse_unsigned< uint32_t >(argv[argi + 1]));
+				argi += 1;
+			} else if (arg == "--seed" && argi + 1 < argc) {
+				config.seed = parse_unsigned< uint64_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--stream-seconds" && argi + 1 < argc) {
+				config.stream_seconds = parse_unsigned< uint32_t >(argv[argi + 1]);
+				argi += 1;
+			} else {
+				std::cerr << "Usage:\n\t" << argv[0] << " [--seconds <n>] [--rate <n>] [--buffer <frames>] [--seed <n>] [--stream-seconds <n>]" << std::endl;
+				return 1;
+			}
+		} catch (std::exception &) {
+			std::cerr << "Expecting a non-negative integer after " << arg << "." << std::endl;
+			return 1;
+		}
+	}
+
+	const uint32_t Rate = 44100;
+
+	//notes from a few milliseconds to about a second long, so voices both run out and get stolen:
+	Mixer mixer;
+	const uint32_t Lengths[] = { 100, 441, 2000, 11025, 44100 };
+	for (uint32_t frames : Lengths) {
+		mixer.add_sound(std::vector< int16_t >(2 * frames, 1));
+	}
+	const uint32_t SoundCount = uint32_t(sizeof(Lengths) / sizeof(Lengths[0]));
+
+	std::atomic< bool > done(false);
+
+	//audio thread: mix one buffer per buffer period, like a device callback would:
+	struct {
+		uint64_t buffers = 0;
+		uint64_t late = 0; //buffers that took longer to mix than they last
+		uint64_t bad_samples = 0;
+		double worst_us = 0.0;
+		double total_us = 0.0;
+	} audio;
+	std::thread audio_thread([&]() {
+		std::vector< int16_t > out(2 * config.buffer);
+		auto period = std::chrono::duration< double >(double(config.buffer) / Rate);
+		auto next = std::chrono::steady_clock::now();
+		while (!done.load(std::memory_order_relaxed)) {
+			auto before = std::chrono::steady_clock::now();
+			mixer.mix(out.data(), config.buffer);
+			auto after = std::chrono::steady_clock::now();
+			double us = std::chrono::duration< double, std::micro >(after - before).count();
+			audio.worst_us = std::max(audio.worst_us, us);
+			audio.total_us += us;
+			if (after - before > period) ++audio.late;
+			++audio.buffers;
+			for (int16_t s : out) {
+				if (s < 0 || s > int16_t(Mixer::MaxVoices)) ++audio.bad_samples;
+			}
+			next += std::chrono::duration_cast< std::chrono::steady_clock::duration >(period);
+			std::this_thread::sleep_until(next);
+		}
+	});
+
+	//game thread (this one): play at 'rate', stop some notes early and ask after others:
+	PCG32 rng(config.seed);
+	uint64_t played = 0, stops = 0, queries = 0, still_playing = 0;
+	std::vector< Mixer::Handle > recent(64, 0);
+	auto before = std::chrono::steady_clock::now();
+	auto end = before + std::chrono::seconds(config.seconds);
+	while (true) {
+		auto now = std::chrono::steady_clock::now();
+		if (now >= end) break;
+		if (config.rate) {
+			//keep to the requested rate on average:
+			double elapsed = std::chrono::duration< double >(now - before).count();
+			if (played + mixer.dropped >= elapsed * config.rate) {
+				std::this_thread::yield();
+				continue;
+			}
+		}
+		Mixer::Handle handle = mixer.play(rng.below(SoundCount), 1.0f);
+		if (handle) {
+			++played;
+			recent[played % recent.size()] = handle;
+		}
+		uint32_t r = rng.below(8);
+		if (r == 0) {
+			mixer.stop(recent[rng.below(uint32_t(recent.size()))]);
+			++stops;
+		} else if (r < 4) {
+			if (mixer.playing(recent[rng.below(uint32_t(recent.size()))])) ++still_playing;
+			++queries;
+		}
+	}
+	double seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+
+	//let the audio thread take everything still queued and play it out (the longest sound is one second):
+	Mixer::Handle last = mixer.next_handle - 1;
+	std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+	done.store(true, std::memory_order_relaxed);
+	audio_thread.join();
+
+	uint64_t unfinished = 0;
+	for (Mixer::Handle handle : recent) {
+		if (mixer.playing(handle)) ++unfinished;
+	}
+
+	std::cout << played << " notes in " << seconds << "s: " << played / seconds << " notes/second, "
+		<< stops << " stops, " << queries << " queries (" << still_playing << " still playing)." << std::endl;
+	std::cout << "  commands dropped (queue full): " << mixer.dropped << ", voices stolen: " << mixer.stolen.load() << std::endl;
+	std::cout << "  " << audio.buffers << " buffers of " << config.buffer << " frames: mix average "
+		<< audio.total_us / std::max< uint64_t >(audio.buffers, 1) << "us, worst " << audio.worst_us << "us (budget "
+		<< 1.0e6 * config.buffer / Rate << "us), " << audio.late << " late." << std::endl;
+
+	bool ok = true;
+	if (audio.bad_samples) {
+		std::cout << "FAIL: " << audio.bad_samples << " samples outside [0, " << uint32_t(Mixer::MaxVoices) << "]." << std::endl;
+		ok = false;
+	}
+	if (mixer.started.load() != last) {
+		std::cout << "FAIL: the last note started was " << mixer.started.load() << ", expected " << last << "." << std::endl;
+		ok = false;
+	}
+	if (unfinished) {
+		std::cout << "FAIL: " << unfinished << " notes still playing after the mixer was drained." << std::endl;
+		ok = false;
+	}
+	if (audio.late) {
+		//(not a handoff failure, but a device would have glitched)
+		std::cout << "WARNING: " << audio.late << " buffers missed their deadline." << std::endl;
+	}
+
+	if (config.stream_seconds) { //streaming: a track much larger than the ring, mixed faster than real time:
+		const uint32_t Speedup = 8;
+		uint32_t frames = config.stream_seconds * Rate;
+		//every frame is distinct and none is silent, so gaps (underruns) can be told apart from data:
+		auto expected = [](uint32_t frame, uint32_t channel) {
+			return int16_t(1 + (frame * 2 + channel) % 30011);
+		};
+		std::string filename = "audio-stress-stream.pcm";
+		{
+			std::vector< int16_t > samples(2 * frames);
+			for (uint32_t f = 0; f < frames; ++f) {
+				samples[2 * f] = expected(f, 0);
+				samples[2 * f + 1] = expected(f, 1);
+			}
+			std::ofstream file(filename, std::ios::binary);
+			write_chunk("pcm0", samples, &file);
+			if (!file) {
+				std::cout << "FAIL: couldn't write '" << filename << "'." << std::endl;
+				return 1;
+			}
+		}
+
+		//each play checked against the track from its start: the first, a replay once it has finished,
+		// one stopped a quarter of the way in, and a replay after that stop:
+		const char *Plays[] = { "streamed", "replayed", "stopped", "replayed after the stop" };
+		const uint32_t PlayCount = uint32_t(sizeof(Plays) / sizeof(Plays[0]));
+		uint32_t received[PlayCount], mismatched[PlayCount];
+		uint32_t ring_bytes = 0;
+		{
+			AudioStream stream(filename, false);
+			ring_bytes = uint32_t(stream.ring.slots.size() * sizeof(int16_t));
+			Mixer streamer;
+			uint32_t track = streamer.add_stream(&stream);
+			std::vector< int16_t > out(2 * config.buffer);
+			auto period = std::chrono::duration< double >(double(config.buffer) / Rate / Speedup);
+			for (uint32_t p = 0; p < PlayCount; ++p) {
+				uint32_t stop_at = (p == 2 ? frames / 4 : -1U);
+				received[p] = mismatched[p] = 0;
+				auto before = std::chrono::steady_clock::now();
+				auto next = before;
+				Mixer::Handle handle = streamer.play(track);
+				while (streamer.playing(handle)) {
+					streamer.mix(out.data(), config.buffer);
+					for (uint32_t f = 0; f < config.buffer; ++f) {
+						if (out[2 * f] == 0 && out[2 * f + 1] == 0) continue;
+						if (received[p] >= frames || out[2 * f] != expected(received[p], 0) || out[2 * f + 1] != expected(received[p], 1)) ++mismatched[p];
+						++received[p];
+					}
+					if (received[p] >= stop_at) {
+						streamer.stop(handle);
+						stop_at = -1U;
+					}
+					next += std::chrono::duration_cast< std::chrono::steady_clock::duration >(period);
+					std::this_thread::sleep_until(next);
+				}
+				std::cout << Plays[p] << " " << received[p] << " of " << frames << " frames (" << frames * 4 / 1024 << "k) through a "
+					<< ring_bytes / 1024 << "k ring in " << std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count()
+					<< "s (" << Speedup << "x real time): " << streamer.underruns.load() << " underruns so far." << std::endl;
+			}
+		}
+		std::remove(filename.c_str());
+
+		for (uint32_t p = 0; p < PlayCount; ++p) {
+			bool whole = (p == 2 ? received[p] >= frames / 4 && received[p] < frames : received[p] == frames);
+			if (!whole || mismatched[p]) {
+				std::cout << "FAIL: " << Plays[p] << ": received " << received[p] << " of " << frames << " frames, " << mismatched[p] << " wrong." << std::endl;
+				ok = false;
+			}
+		}
+	}
+
+	if (ok) std::cout << "OK" << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+//job-bench measures how the Jobs scheduler scales from one thread to every
+// core on a synthetic loading workload, and checks that the results don't
+// depend on the number of threads.
+// Usage: job-bench [--levels <n>] [--board <tiles>] [--chunk <tiles>] [--threads <max>] [--seed <n>]
+//
+// Each level is one job that lays out its counters (Simulation::make_level on
+// a --board x --board board) followed -- through a Counter dependency -- by
+// jobs that each build the object-to-clip transforms for --chunk of its tiles,
+// the way Game::draw builds them for the board layer.
+// The widest run is repeated with the profiling hook installed, to show where
+// the time went and what the hook costs.
+
+#include "Jobs.hpp"
+#include "Simulation.hpp"
+#include "parse_unsigned.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+int main(int argc, char **argv) {
+	struct {
+		uint32_t levels = 64;
+		uint32_t board = 129;
+		uint32_t chunk = 1024;
+		uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+		uint64_t seed = 0;
+	} config;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		try {
+			if (arg == "--levels" && argi + 1 < argc) {
+				config.levels = std::max(1u, parse_unsigned< uint32_t >(argv[argi + 1]));
+				argi += 1;
+			} else if (arg == "--board" && argi + 1 < argc) {
+				config.board = std::max(3u, parse_unsigned< uint32_t >(argv[argi + 1]));
+				argi += 1;
+			} else if (arg == "--chunk" && argi + 1 < argc) {
+				config.chunk = std::max(1u, parse_unsigned< uint32_t >(argv[argi + 1]));
+				argi += 1;
+			} else if (arg == "--threads" && argi + 1 < argc) {
+				config.threads = std::max(1u, parse_unsigned< uint32_t >(argv[argi + 1]));
+				argi += 1;
+			} else if (arg == "--seed" && argi + 1 < argc) {
+				config.seed = parse_unsigned< uint64_t >(argv[argi + 1]);
+				argi += 1;
+			} else {
+				std::cerr << "Usage:\n\t" << argv[0] << " [--levels <n>] [--board <tiles>] [--chunk <tiles>] [--threads <max>] [--seed <n>]" << std::endl;
+				return 1;
+			}
+		} catch (std::exception &) {
+			std::cerr << "Expecting a non-negative integer after " << arg << "." << std::endl;
+			return 1;
+		}
+	}
+
+	const glm::uvec2 Board = glm::uvec2(config.board, config.board);
+	const uint32_t Cells = Board.x * Board.y;
+	const uint32_t Chunks = (Cells + config.chunk - 1) / config.chunk;
+
+	//same view as Game::draw (fit the board to a square window, sheared and flattened):
+	glm::mat4 world_to_clip;
+	{
+		float scale = 1.75f / float(Board.x);
+		glm::vec2 center = 0.5f * glm::vec2(Board);
+		world_to_clip = glm::mat4(
+			scale, 0.0f, 0.0f, 0.0f,
+			0.0f, scale, 0.0f, 0.0f,
+			0.0f, 0.0f, -1.0f, 0.0f,
+			-scale * center.x, -scale * center.y, 0.0f, 1.0f
+		);
+		glm::mat4 shear_z = glm::mat4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			-2.0f, 3.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f
+		);
+		world_to_clip = world_to_clip * shear_z * glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 1.0f, 0.25f));
+	}
+
+	//per-name busy time and per-thread job counts, filled by the profiling hook:
+	struct Profile {
+		std::vector< std::map< std::string, double > > busy_ms; //[worker][name] (each worker only touches its own map)
+		std::vector< uint64_t > jobs; //[worker]
+	};
+	auto hook = [](void *user, char const *name, uint32_t worker, Jobs::Clock::time_point begin, Jobs::Clock::time_point end) {
+		Profile &profile = *reinterpret_cast< Profile * >(user);
+		profile.busy_ms[worker][name] += std::chrono::duration< double, std::milli >(end - begin).count();
+		profile.jobs[worker] += 1;
+	};
+
+	//one pass over every level with 'threads' threads:
+	struct Result {
+		double seconds = 0.0;
+		double checksum = 0.0;
+		uint64_t stolen = 0;
+		std::vector< uint64_t > executed; //per thread
+	};
+	auto run = [&](uint32_t threads, Profile *profile) {
+		std::vector< Simulation::Level > levels(config.levels);
+		std::vector< glm::mat4 > transforms(size_t(config.levels) * (Cells + Simulation::CounterCount));
+		std::vector< double > sums(size_t(config.levels) * Chunks, 0.0);
+		std::unique_ptr< Jobs::Counter[] > laid_out(new Jobs::Counter[config.levels]);
+		Jobs::Counter done;
+
+		Result result;
+		auto before = std::chrono::steady_clock::now();
+		{
+			Jobs jobs(threads - 1);
+			if (profile) {
+				profile->busy_ms.assign(threads, std::map< std::string, double >());
+				profile->jobs.assign(threads, 0);
+				jobs.hook = hook;
+				jobs.hook_user = profile;
+			}
+			for (uint32_t l = 0; l < config.levels; ++l) {
+				jobs.run("make_level", [&, l]() {
+					levels[l] = Simulation::make_level(config.seed, l, Board, glm::vec2(Board / 2u), 1.0f);
+				}, &laid_out[l]);
+				for (uint32_t c = 0; c < Chunks; ++c) {
+					jobs.run_after(&laid_out[l], "transforms", [&, l, c]() {
+						glm::mat4 *out = &transforms[size_t(l) * (Cells + Simulation::CounterCount)];
+						double sum = 0.0;
+						auto add = [&](uint32_t i, glm::vec3 location, glm::quat rotation) {
+							out[i] = world_to_clip * glm::translate(glm::mat4(1.0f), location) * glm::mat4_cast(rotation);
+							sum += out[i][3][0] + out[i][3][1];
+						};
+						//(the first chunk also places the level's key counters)
+						if (c == 0) {
+							for (uint32_t k = 0; k < Simulation::CounterCount; ++k) {
+								Simulation::CounterInfo const &counter = levels[l].counters[k];
+								add(Cells + k, glm::vec3(counter.location), counter.rotation);
+							}
+						}
+						for (uint32_t i = c * config.chunk; i < std::min(Cells, (c + 1) * config.chunk); ++i) {
+							add(i, glm::vec3(i % Board.x, i / Board.x, -0.5f), glm::quat());
+						}
+						sums[size_t(l) * Chunks + c] = sum;
+					}, &done);
+				}
+			}
+			jobs.wait(&done);
+			result.seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+			for (auto const &worker : jobs.workers) {
+				result.executed.emplace_back(worker->executed.load());
+				result.stolen += worker->stolen.load();
+			}
+		}
+		//(summed in a fixed order, so any thread count gives the same total)
+		for (double s : sums) result.checksum += s;
+		return result;
+	};
+
+	std::cout << config.levels << " levels of " << config.board << "x" << config.board << " (" << Chunks
+		<< " transform jobs of " << config.chunk << " tiles each), up to " << config.threads << " threads:" << std::endl;
+
+	bool ok = true;
+	std::vector< uint32_t > counts;
+	for (uint32_t t = 1; t < config.threads; t *= 2) counts.emplace_back(t);
+	counts.emplace_back(config.threads);
+
+	run(1, nullptr); //(warm up: page in the buffers, start the clock at full speed)
+	double baseline = 0.0, reference = 0.0;
+	for (uint32_t threads : counts) {
+		Result result = run(threads, nullptr);
+		if (threads == 1) {
+			baseline = result.seconds;
+			reference = result.checksum;
+		}
+		uint64_t most = *std::max_element(result.executed.begin(), result.executed.end());
+		uint64_t least = *std::min_element(result.executed.begin(), result.executed.end());
+		std::cout << "  " << (threads < 10 ? " " : "") << threads << " threads: " << result.seconds * 1000.0 << "ms, speedup "
+			<< baseline / result.seconds << "x (" << 100.0 * baseline / result.seconds / threads << "% efficiency), "
+			<< result.stolen << " steals, jobs per thread " << least << "-" << most << std::endl;
+		if (result.checksum != reference) {
+			std::cerr << "  checksum " << result.checksum << " differs from the one-thread run's " << reference << "!" << std::endl;
+			ok = false;
+		}
+	}
+
+	{ //the widest run again, with the profiling hook:
+		uint32_t threads = counts.back();
+		double plain = run(threads, nullptr).seconds;
+		Profile profile;
+		double hooked = run(threads, &profile).seconds;
+		std::map< std::string, double > total;
+		double busy = 0.0;
+		for (auto const &worker : profile.busy_ms) {
+			for (auto const &entry : worker) {
+				total[entry.first] += entry.second;
+				busy += entry.second;
+			}
+		}
+		std::cout << "  profiled (" << threads << " threads): " << hooked * 1000.0 << "ms vs. " << plain * 1000.0
+			<< "ms without the hook; threads busy " << 100.0 * busy / (hooked * 1000.0 * threads) << "% of the time" << std::endl;
+		for (auto const &entry : total) {
+			std::cout << "    " << entry.first << ": " << entry.second << "ms total" << std::endl;
+		}
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,290 @@
+//levelgen generates first-level layouts for many seeds on every core, scores
+// them, prints quality histograms and throughput, and saves the best seeds to a
+// level pack.
+// Usage: levelgen [--seeds <n>] [--first <n>] [--threads <n>] [--board <n>] [--best <n>] [--out <file>]
+//
+// Scores (all in tiles, on the integer board grid):
+//  separation: smallest Chebyshev distance between two key counters
+//  spawn: Manhattan length of the walk from the avatar's start to the nearest
+//         key counter, stopping on the inside tile next to it
+//  path: Manhattan length of the walk from the start through level_progression,
+//        stopping on the inside tile next to each counter
+// (the board's interior is open floor, so a Manhattan walk is the shortest one)
+// "Best" means longest path, then widest separation, then most room at spawn.
+//
+// Level pack format (read back with read_chunk):
+//  "lvp0": one PackEntry per saved seed, best first.
+
+#include "Simulation.hpp"
+#include "write_chunk.hpp"
+#include "parse_unsigned.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+struct PackEntry {
+	uint64_t seed;
+	uint8_t board_size[2];
+	uint8_t counters[Simulation::CounterCount][2]; //x,y of each key counter
+	uint8_t separation;
+	uint8_t spawn;
+	uint16_t path;
+	uint16_t reserved;
+};
+static_assert(sizeof(PackEntry) == 24, "PackEntry should be packed.");
+
+struct Score {
+	uint32_t separation = 0;
+	uint32_t spawn = 0;
+	uint32_t path = 0;
+
+	bool operator<(Score const &o) const {
+		if (path != o.path) return path < o.path;
+		if (separation != o.separation) return separation < o.separation;
+		return spawn < o.spawn;
+	}
+};
+
+static uint32_t chebyshev(glm::ivec2 a, glm::ivec2 b) {
+	return uint32_t(std::max(std::abs(a.x - b.x), std::abs(a.y - b.y)));
+}
+
+static uint32_t manhattan(glm::ivec2 a, glm::ivec2 b) {
+	return uint32_t(std::abs(a.x - b.x) + std::abs(a.y - b.y));
+}
+
+//the inside tile next to a counter, where a walk to it stops:
+static glm::ivec2 inside_tile(Simulation const &sim, glm::uvec3 const &location) {
+	glm::ivec2 inside_hi = glm::ivec2(sim.board_size) - glm::ivec2(2, 2);
+	return glm::ivec2(
+		std::min(std::max(int32_t(location.x), 1), inside_hi.x),
+		std::min(std::max(int32_t(location.y), 1), inside_hi.y)
+	);
+}
+
+static Score score(Simulation const &sim, Simulation::Level const &level, glm::ivec2 spawn) {
+	Score s;
+	s.separation = -1U;
+	s.spawn = -1U;
+	for (uint32_t i = 0; i < Simulation::CounterCount; ++i) {
+		glm::ivec2 at = glm::ivec2(level.counters[i].location.x, level.counters[i].location.y);
+		s.spawn = std::min(s.spawn, manhattan(spawn, inside_tile(sim, level.counters[i].location)));
+		for (uint32_t j = 0; j < i; ++j) {
+			glm::ivec2 other = glm::ivec2(level.counters[j].location.x, level.counters[j].location.y);
+			s.separation = std::min(s.separation, chebyshev(at, other));
+		}
+	}
+
+	glm::ivec2 walker = spawn;
+	for (uint32_t p = 0; p < sim.progression_length; ++p) {
+		glm::ivec2 stop = inside_tile(sim, level.counters[sim.level_progression[p]].location);
+		s.path += manhattan(walker, stop);
+		walker = stop;
+	}
+	return s;
+}
+
+int main(int argc, char **argv) {
+	struct {
+		uint64_t seeds = 1000000;
+		uint64_t first = 0;
+		uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+		uint32_t board = 9;
+		uint32_t best = 64;
+		std::string out = "levels.pack";
+	} config;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		try {
+			if (arg == "--seeds" && argi + 1 < argc) {
+				config.seeds = parse_unsigned< uint64_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--first" && argi + 1 < argc) {
+				config.first = parse_unsigned< uint64_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--threads" && argi + 1 < argc) {
+				config.threads = std::max(1u, parse_unsigned< uint32_t >(argv[argi + 1]));
+				argi += 1;
+			} else if (arg == "--board" && argi + 1 < argc) {
+				config.board = parse_unsigned< uint32_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--best" && argi + 1 < argc) {
+				config.best = parse_unsigned< uint32_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--out" && argi + 1 < argc) {
+				config.out = argv[argi + 1];
+				argi += 1;
+			} else {
+				std::cerr << "Usage:\n\t" << argv[0] << " [--seeds <n>] [--first <n>] [--threads <n>] [--board <n>] [--best <n>] [--out <file>]" << std::endl;
+				return 1;
+			}
+		} catch (std::exception &) {
+			std::cerr << "Expecting a non-negative integer after " << arg << "." << std::endl;
+			return 1;
+		}
+	}
+	if (config.board < 5 || config.board > 255) {
+		std::cerr << "Board size must be in [5, 255] (level packs store coordinates as bytes)." << std::endl;
+		return 1;
+	}
+
+	//the first level of a Simulation with this board, as generate_level would make it:
+	Simulation base(0);
+	base.board_size = glm::uvec2(config.board, config.board);
+	base.avatar_location = glm::vec3(glm::vec2(base.board_size / 2u), 0.0f);
+	glm::ivec2 spawn = glm::ivec2(glm::vec2(base.avatar_location));
+
+	//per-thread results, merged at the end:
+	struct Results {
+		std::vector< uint64_t > separation, spawn, path; //histograms, indexed by score
+		std::vector< std::pair< Score, uint64_t > > best; //(score, seed), kept as a min-heap of size config.best
+		uint64_t layouts = 0;
+		uint64_t failures = 0; //seeds whose layout threw
+	};
+	std::vector< Results > results(config.threads);
+
+	auto better = [](std::pair< Score, uint64_t > const &a, std::pair< Score, uint64_t > const &b) {
+		//ties go to the lower seed, so the output doesn't depend on thread timing:
+		if (a.first < b.first || b.first < a.first) return b.first < a.first;
+		return a.second < b.second;
+	};
+
+	//seeds are handed out in blocks from a shared counter, so threads that finish early take more:
+	const uint64_t Block = 4096;
+	std::atomic< uint64_t > next_block(0);
+
+	auto work = [&](Results *res) {
+		while (true) {
+			uint64_t begin = next_block.fetch_add(Block);
+			if (begin >= config.seeds) break;
+			uint64_t end = std::min(config.seeds, begin + Block);
+			for (uint64_t i = begin; i < end; ++i) {
+				uint64_t seed = config.first + i;
+				Simulation::Level level;
+				try {
+					level = Simulation::make_level(seed, 0, base.board_size, glm::vec2(base.avatar_location), 1.0f);
+				} catch (std::runtime_error &) {
+					++res->failures;
+					continue;
+				}
+				Score s = score(base, level, spawn);
+				++res->layouts;
+
+				auto bump = [](std::vector< uint64_t > &hist, uint32_t value) {
+					if (value >= hist.size()) hist.resize(value + 1, 0);
+					++hist[value];
+				};
+				bump(res->separation, s.separation);
+				bump(res->spawn, s.spawn);
+				bump(res->path, s.path);
+
+				//min-heap by quality: the root is the worst of the kept seeds:
+				std::pair< Score, uint64_t > entry(s, seed);
+				if (res->best.size() < config.best) {
+					res->best.emplace_back(entry);
+					std::push_heap(res->best.begin(), res->best.end(), better);
+				} else if (!res->best.empty() && better(entry, res->best.front())) {
+					std::pop_heap(res->best.begin(), res->best.end(), better);
+					res->best.back() = entry;
+					std::push_heap(res->best.begin(), res->best.end(), better);
+				}
+			}
+		}
+	};
+
+	auto before = std::chrono::high_resolution_clock::now();
+	{
+		std::vector< std::thread > threads;
+		for (uint32_t t = 1; t < config.threads; ++t) {
+			threads.emplace_back(work, &results[t]);
+		}
+		work(&results[0]);
+		for (auto &t : threads) t.join();
+	}
+	auto after = std::chrono::high_resolution_clock::now();
+	double seconds = std::chrono::duration< double >(after - before).count();
+
+	//merge:
+	Results total;
+	for (Results const &res : results) {
+		auto merge = [](std::vector< uint64_t > &into, std::vector< uint64_t > const &from) {
+			if (from.size() > into.size()) into.resize(from.size(), 0);
+			for (uint32_t i = 0; i < from.size(); ++i) into[i] += from[i];
+		};
+		merge(total.separation, res.separation);
+		merge(total.spawn, res.spawn);
+		merge(total.path, res.path);
+		total.best.insert(total.best.end(), res.best.begin(), res.best.end());
+		total.layouts += res.layouts;
+		total.failures += res.failures;
+	}
+	std::sort(total.best.begin(), total.best.end(), better);
+	if (total.best.size() > config.best) total.best.resize(config.best);
+
+	std::cout << total.layouts << " layouts (" << config.board << "x" << config.board << " board) in " << seconds << "s on "
+		<< config.threads << " threads: " << total.layouts / seconds << " layouts/second ("
+		<< total.layouts / seconds / config.threads << " per thread)." << std::endl;
+	if (total.failures) {
+		std::cout << "  " << total.failures << " seeds could not place every counter." << std::endl;
+	}
+
+	auto print_histogram = [&](char const *name, std::vector< uint64_t > const &hist) {
+		std::cout << name << ":\n";
+		uint64_t most = std::max< uint64_t >(1, hist.empty() ? 1 : *std::max_element(hist.begin(), hist.end()));
+		for (uint32_t v = 0; v < hist.size(); ++v) {
+			if (hist[v] == 0) continue;
+			std::string bar(size_t(50 * hist[v] / most), '#');
+			std::cout << "  " << (v < 10 ? " " : "") << v << " " << bar << " " << hist[v] << "\n";
+		}
+	};
+	print_histogram("separation", total.separation);
+	print_histogram("spawn", total.spawn);
+	print_histogram("path", total.path);
+	std::cout.flush();
+
+	//save the best seeds:
+	std::vector< PackEntry > pack;
+	pack.reserve(total.best.size());
+	for (auto const &b : total.best) {
+		Simulation::Level level = Simulation::make_level(b.second, 0, base.board_size, glm::vec2(base.avatar_location), 1.0f);
+		PackEntry entry;
+		std::memset(&entry, 0, sizeof(entry));
+		entry.seed = b.second;
+		entry.board_size[0] = uint8_t(base.board_size.x);
+		entry.board_size[1] = uint8_t(base.board_size.y);
+		for (uint32_t i = 0; i < Simulation::CounterCount; ++i) {
+			entry.counters[i][0] = uint8_t(level.counters[i].location.x);
+			entry.counters[i][1] = uint8_t(level.counters[i].location.y);
+		}
+		entry.separation = uint8_t(b.first.separation);
+		entry.spawn = uint8_t(b.first.spawn);
+		entry.path = uint16_t(b.first.path);
+		pack.emplace_back(entry);
+	}
+
+	std::ofstream out(config.out, std::ios::binary);
+	write_chunk("lvp0", pack, &out);
+	if (!out) {
+		std::cerr << "Failed to write level pack '" << config.out << "'." << std::endl;
+		return 1;
+	}
+	if (!pack.empty()) {
+		std::cout << "Saved " << pack.size() << " seeds to '" << config.out << "' (best: seed " << pack[0].seed
+			<< ", path " << pack[0].path << ", separation " << uint32_t(pack[0].separation)
+			<< ", spawn " << uint32_t(pack[0].spawn) << ")." << std::endl;
+	}
+
+	return 0;
+}
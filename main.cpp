@@ -1,6 +1,21 @@
 //Game.hpp declares the "game" object, which handles game-specific stuff:
 #include "Game.hpp"
 
+//Recording.hpp declares the input/timing log used by --record and --replay:
+#include "Recording.hpp"
+
+//TripleBuffer.hpp passes frame packets from the main thread to the render thread:
+#include "TripleBuffer.hpp"
+
+//Histogram.hpp keeps the per-phase timing distributions reported on exit:
+#include "Histogram.hpp"
+
+//parse_unsigned.hpp parses numeric options (rejecting negative numbers, which stoull would wrap):
+#include "parse_unsigned.hpp"
+
+//gl_errors.hpp checks for (and prints) OpenGL errors once per frame:
+#include "gl_errors.hpp"
+
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
 
@@ -13,19 +28,84 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 //...and for c++ standard library functions:
+#include <atomic>
 #include <chrono>
+#include <csignal>
 #include <iostream>
 #include <stdexcept>
 #include <fstream>
 #include <memory>
 #include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+
+//set by SIGUSR1; the main loop prints (and saves) the phase timings when it sees it:
+static volatile std::sig_atomic_t timings_requested = 0;
 
 int main(int argc, char **argv) {
 	struct {
 		std::string title = "Undercooked";
 		glm::uvec2 size = glm::uvec2(640, 640);
+		uint64_t seed = std::random_device()(); //level generation seed; override with --seed
+		std::string record_file = ""; //if set, save the session's seed, input and timing here on exit
+		std::string replay_file = ""; //if set, play this recording back instead of reading input
+		bool replay_fast = false; //replay as fast as possible instead of at the original speed
+		bool bot = false; //let a bot play (keyboard input is still handled, but the bot overrides movement)
+		std::string timings_prefix = ""; //if set, save phase timings to <prefix>.csv and <prefix>.json on exit (and on SIGUSR1)
 	} config;
 
+	//------------  command line ------------
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--seed" && argi + 1 < argc) {
+			try {
+				config.seed = parse_unsigned< uint64_t >(argv[argi + 1]);
+			} catch (std::exception &) {
+				std::cerr << "Expecting a non-negative integer after --seed, got '" << argv[argi + 1] << "'." << std::endl;
+				return 1;
+			}
+			argi += 1;
+		} else if (arg == "--record" && argi + 1 < argc) {
+			config.record_file = argv[argi + 1];
+			argi += 1;
+		} else if (arg == "--replay" && argi + 1 < argc) {
+			config.replay_file = argv[argi + 1];
+			argi += 1;
+		} else if (arg == "--replay-fast") {
+			config.replay_fast = true;
+		} else if (arg == "--bot") {
+			config.bot = true;
+		} else if (arg == "--timings" && argi + 1 < argc) {
+			config.timings_prefix = argv[argi + 1];
+			argi += 1;
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--seed <n>] [--bot] [--record <file>] [--replay <file> [--replay-fast]] [--timings <prefix>]" << std::endl;
+			return 1;
+		}
+	}
+
+	Recording recording; //filled in when recording
+	Recording replay; //loaded when replaying
+	if (config.replay_file != "") {
+		try {
+			replay.load(config.replay_file);
+		} catch (std::exception &e) {
+			std::cerr << "Failed to load replay: " << e.what() << std::endl;
+			return 1;
+		}
+		config.seed = replay.seed;
+		config.bot = replay.bot;
+		std::cout << "Replaying '" << config.replay_file << "' (" << replay.frames.size() << " frames, "
+			<< (config.replay_fast ? "maximum" : "original") << " speed)." << std::endl;
+	}
+	recording.seed = config.seed;
+	recording.bot = config.bot;
+
+	//print the seed so any session's levels can be reproduced:
+	std::cout << "Level seed: " << config.seed << " (use --seed " << config.seed << " to repeat)" << std::endl;
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
@@ -83,6 +163,11 @@ int main(int argc, char **argv) {
 		}
 	}
 
+	//A fast replay shouldn't be paced by the display:
+	if (config.replay_fast) {
+		SDL_GL_SetSwapInterval(0);
+	}
+
 	//Hide mouse cursor (note: showing can be useful for debugging):
 	//SDL_ShowCursor(SDL_DISABLE);
 
@@ -90,9 +175,10 @@ int main(int argc, char **argv) {
 	//------------ create game object (loads assets) --------------
 
 	// shared_ptr ref deleted when last shared_ptr to ref is destroyed (e.g. exceptions)
-	std::shared_ptr< Game > game = std::make_shared< Game >();
+	std::shared_ptr< Game > game = std::make_shared< Game >(config.seed);
+	game->bot = config.bot;
 
-	//------------ main loop ------------
+	//------------ loop state ------------
 
 	//the window created above is resizable; this inline function will be
 	//called whenever the window is resized, and will update the window_size
@@ -106,65 +192,369 @@ int main(int argc, char **argv) {
 		window_size = glm::uvec2(w, h);
 		SDL_GL_GetDrawableSize(window, &w, &h);
 		drawable_size = glm::uvec2(w, h);
-		glViewport(0, 0, drawable_size.x, drawable_size.y);	// Specify viewport size for Gl
+		//(the render thread sets the GL viewport when a frame packet arrives with a new size)
 	};
 	on_resize();
 
-	//This will loop until the game object is set to null:
-	while (game) {
-		//every pass through the game loop creates one frame of output
+	//profiler scopes for each phase of the main loop (see the 'P' overlay):
+	uint32_t update_scope = game->profiler.add_scope("update", false);
+	uint32_t draw_scope = game->profiler.add_scope("draw", true);
+	uint32_t swap_scope = game->profiler.add_scope("swap", false);
+
+	//frame scheduling state: frames are only drawn+swapped when something visible changed,
+	//and the loop blocks on events (instead of spinning on vsync) when idle or hidden:
+	struct {
+		bool hidden = false; //minimized or hidden: never draw
+		bool focused = true; //unfocused: draw at a reduced rate
+		bool force_redraw = true; //window contents were lost (expose/resize) and must be redrawn
+		bool published = true; //whether the last pass through the loop published a frame to draw
+	} schedule;
+	const int IdleWaitMS = 1000; //nothing is moving: wait (almost) indefinitely for input
+	const int SkippedFrameWaitMS = 16; //something is active but nothing visible changed: roughly one 60Hz frame
+	const int UnfocusedFrameMS = 33; //throttle to ~30Hz when the window doesn't have focus
+	const int HiddenTickMS = 100; //keep simulating at 10Hz while minimized
+
+	//the simulation runs in fixed-length steps; leftover time carries over to the next frame
+	//and is used to interpolate the drawn state between the last two steps:
+	const float SimulationStep = 1.0f / 120.0f;
+	const uint32_t MaxStepsPerFrame = 30; //if frames take longer than this, lag instead of spiralling
+	float accumulator = 0.0f;
+	float alpha = 0.0f;
+
+	auto previous_time = std::chrono::high_resolution_clock::now();
+
+	//position in the replay (if replaying):
+	bool replaying = (config.replay_file != "");
+	uint32_t replay_frame = 0;
+	uint32_t replay_event = 0;
+	auto replay_start = previous_time;
+
+	//------------ phase timing ------------
+
+	//every pass records how long each phase took, on whichever thread runs it:
+	// (the event phase leaves out time spent deliberately blocked waiting for events,
+	//  and 'frame' is the time from one swap to the next)
+	enum Phase : uint32_t { EventsPhase, UpdatePhase, DrawPhase, GLErrorsPhase, SwapPhase, FramePhase, PhaseCount };
+	char const *PhaseNames[PhaseCount] = { "events", "update", "draw", "gl_errors", "swap", "frame" };
+	Histogram phases[PhaseCount];
+	//record the time since 'begin' in 'phase', and return the end time (the begin of whatever comes next):
+	auto end_phase = [&phases](Phase phase, std::chrono::high_resolution_clock::time_point begin) {
+		auto end = std::chrono::high_resolution_clock::now();
+		phases[phase].record(uint64_t(std::chrono::duration_cast< std::chrono::nanoseconds >(end - begin).count()));
+		return end;
+	};
+
+	//what one sample costs (a clock read plus a record), to report the timing's own overhead:
+	double sample_ns = 0.0;
+	{
+		Histogram scratch;
+		const uint32_t Samples = 10000;
+		auto before = std::chrono::high_resolution_clock::now();
+		auto t = before;
+		for (uint32_t i = 0; i < Samples; ++i) {
+			auto now = std::chrono::high_resolution_clock::now();
+			scratch.record(uint64_t(std::chrono::duration_cast< std::chrono::nanoseconds >(now - t).count()));
+			t = now;
+		}
+		sample_ns = std::chrono::duration< double, std::nano >(std::chrono::high_resolution_clock::now() - before).count() / Samples;
+	}
+	auto timing_start = std::chrono::high_resolution_clock::now();
+
+	auto report_timings = [&]() {
+		HistogramReport report;
+		uint64_t samples = 0;
+		for (uint32_t p = 0; p < PhaseCount; ++p) {
+			report.emplace_back(PhaseNames[p], phases[p].summarize());
+			samples += report.back().second.count;
+		}
+		double run_ns = std::chrono::duration< double, std::nano >(std::chrono::high_resolution_clock::now() - timing_start).count();
+		std::cout << "Phase timings:" << std::endl;
+		write_table(report, &std::cout);
+		std::cout << "  (timing cost: " << samples << " samples at ~" << sample_ns << "ns, "
+			<< 100.0 * samples * sample_ns / std::max(run_ns, 1.0) << "% of the run)" << std::endl;
+		if (config.timings_prefix != "") {
+			std::ofstream csv(config.timings_prefix + ".csv");
+			write_csv(report, &csv);
+			std::ofstream json(config.timings_prefix + ".json");
+			write_json(report, &json);
+			if (csv && json) {
+				std::cout << "Saved phase timings to '" << config.timings_prefix << ".csv' and '" << config.timings_prefix << ".json'." << std::endl;
+			} else {
+				std::cerr << "Failed to save phase timings to '" << config.timings_prefix << ".csv/.json'." << std::endl;
+			}
+		}
+	};
+
+	#ifndef _WIN32
+	//'kill -USR1 <pid>' reports the timings so far without quitting:
+	std::signal(SIGUSR1, [](int) { timings_requested = 1; });
+	#endif
+
+	//------------ render thread ------------
+
+	//the render thread owns the GL context from here on: it takes the newest frame packet,
+	//draws it and swaps, while this thread handles events and runs update.
+	//Packets go through a triple buffer, so neither thread waits on the other to hand one over;
+	//the semaphores only pace them (wake the renderer; keep this thread at most a frame ahead).
+	TripleBuffer< Game::FramePacket > frames;
+	SDL_sem *frame_published = SDL_CreateSemaphore(0);
+	SDL_sem *frame_presented = SDL_CreateSemaphore(0);
+	std::atomic< uint32_t > presented_sequence(0); //sequence of the last packet swapped to the screen
+	std::atomic< bool > render_quit(false);
+	std::atomic< bool > render_failed(false);
+	const uint32_t MaxFramesAhead = 2; //packets published but not yet presented before this thread waits
+	uint32_t published_sequence = 0;
+	double update_ms = 0.0; //total time spent in update (reported to the profiler through the packets)
+
+	SDL_GL_MakeCurrent(window, NULL);
+	std::thread render_thread([&](){
+		SDL_GL_MakeCurrent(window, context);
+		glm::uvec2 viewport_size = glm::uvec2(0, 0);
+		double update_ms_seen = 0.0;
+		bool swapped = false;
+		auto last_swap = std::chrono::high_resolution_clock::now();
+		try {
+			while (!render_quit.load(std::memory_order_relaxed)) {
+				if (!frames.acquire()) {
+					SDL_SemWaitTimeout(frame_published, 100);
+					continue;
+				}
+				Game::FramePacket const &frame = frames.read_slot();
+
+				game->profiler.begin_frame();
+				game->gl_state.begin_frame();
+				game->profiler.add_cpu_ms(update_scope, float(frame.update_ms - update_ms_seen));
+				update_ms_seen = frame.update_ms;
+
+				if (frame.drawable_size != viewport_size) {
+					viewport_size = frame.drawable_size;
+					glViewport(0, 0, viewport_size.x, viewport_size.y);
+				}
+
+				auto phase_begin = std::chrono::high_resolution_clock::now();
+				{ //call the game's "draw" function to produce output:
+					Profiler::Marker marker(game->profiler, draw_scope);
+
+					//clear the depth+color buffers and set some default state:
+					// (through the game's state cache, so after the first frame these are no-ops)
+					game->gl_state.clear_color(glm::vec4(0.5f, 0.5f, 0.5f, 0.0f));
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					game->gl_state.enable(GL_DEPTH_TEST);
+					game->gl_state.enable(GL_BLEND);
+					game->gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+					game->draw(frame);
+				}
+				phase_begin = end_phase(DrawPhase, phase_begin);
+
+				//(may wait for the GL to catch up, so it gets its own phase)
+				GL_ERRORS();
+				phase_begin = end_phase(GLErrorsPhase, phase_begin);
+
+				//Finally, wait until the recently-drawn frame is shown before taking the next:
+				{
+					Profiler::Marker marker(game->profiler, swap_scope);
+					SDL_GL_SwapWindow(window);
+				}
+				auto swap_end = end_phase(SwapPhase, phase_begin);
+				if (swapped) end_phase(FramePhase, last_swap);
+				swapped = true;
+				last_swap = swap_end;
+				presented_sequence.store(frame.sequence, std::memory_order_release);
+				SDL_SemPost(frame_presented);
+			}
+		} catch (std::exception &e) {
+			std::cerr << "Render thread stopped: " << e.what() << std::endl;
+			render_failed.store(true);
+		}
+		SDL_GL_MakeCurrent(window, NULL);
+	});
+
+	//------------ main loop ------------
+
+	//This will loop until the game is quit (or the render thread fails):
+	bool quit = false;
+	while (!quit && !render_failed.load()) {
+		if (timings_requested) {
+			timings_requested = 0;
+			report_timings();
+		}
+
+		//every pass through the game loop publishes (at most) one frame of output
 		//  by performing three steps:
 
 		{ //(1) process any events that are pending
 			static SDL_Event evt;
-			while (SDL_PollEvent(&evt) == 1) {
-				//handle resizing:
-				if (evt.type == SDL_WINDOWEVENT && evt.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-					on_resize();
+
+			//decide whether to block for events before polling:
+			// (replays never block: their timing comes from the recording)
+			int wait_ms = -1;
+			if (replaying) {
+				wait_ms = -1;
+			} else if (schedule.hidden) {
+				wait_ms = HiddenTickMS;
+			} else if (!schedule.published) {
+				wait_ms = (game->is_idle() ? IdleWaitMS : SkippedFrameWaitMS);
+			} else if (!schedule.focused) {
+				wait_ms = UnfocusedFrameMS;
+			}
+
+			bool have_event = false;
+			if (wait_ms >= 0) {
+				bool was_idle = game->is_idle();
+				have_event = (SDL_WaitEventTimeout(&evt, wait_ms) == 1);
+				//time spent blocked while idle shouldn't show up as one huge update step:
+				if (was_idle) {
+					previous_time = std::chrono::high_resolution_clock::now();
+				}
+			}
+			auto events_begin = std::chrono::high_resolution_clock::now();
+
+			while (have_event || SDL_PollEvent(&evt) == 1) {
+				have_event = false;
+				//handle resizing and visibility:
+				if (evt.type == SDL_WINDOWEVENT) {
+					if (evt.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+						on_resize();
+						schedule.force_redraw = true;
+					} else if (evt.window.event == SDL_WINDOWEVENT_MINIMIZED || evt.window.event == SDL_WINDOWEVENT_HIDDEN) {
+						schedule.hidden = true;
+					} else if (evt.window.event == SDL_WINDOWEVENT_RESTORED || evt.window.event == SDL_WINDOWEVENT_SHOWN
+					        || evt.window.event == SDL_WINDOWEVENT_MAXIMIZED) {
+						schedule.hidden = false;
+						schedule.force_redraw = true;
+					} else if (evt.window.event == SDL_WINDOWEVENT_EXPOSED) {
+						schedule.force_redraw = true;
+					} else if (evt.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
+						schedule.focused = true;
+					} else if (evt.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+						schedule.focused = false;
+					}
+				}
+				//while replaying, live keyboard input is ignored:
+				if (replaying && (evt.type == SDL_KEYDOWN || evt.type == SDL_KEYUP)) continue;
+				//keep track of input the game sees, for --record:
+				if (config.record_file != "") {
+					recording.add_event(evt);
 				}
 				//handle input:
-				if (game && game->handle_event(evt, window_size)) {
+				if (game->handle_event(evt, window_size)) {
 					// mode handled it; great
 				} else if (evt.type == SDL_QUIT) {
-					game.reset(); //done: deallocate game
+					quit = true; //done: stop the loop
 					break;
 				}
 			}
-			if (!game) break;
+			if (quit) break;
+
+			//feed this frame's recorded events to the game:
+			if (replaying && replay_frame < replay.frames.size()) {
+				for (uint32_t i = 0; i < replay.frames[replay_frame].events; ++i) {
+					SDL_Event recorded = Recording::to_sdl(replay.events[replay_event++]);
+					if (game->handle_event(recorded, window_size)) {
+						// mode handled it; great
+					} else if (recorded.type == SDL_QUIT) {
+						quit = true;
+						break;
+					}
+				}
+			}
+			if (quit) break;
+			end_phase(EventsPhase, events_begin);
 		}
 
-		{ //(2) call the game's "update" function to deal with elapsed time:
+		{ //(2) call the game's "update" function once per whole simulation step that has elapsed:
 			auto current_time = std::chrono::high_resolution_clock::now();
-			static auto previous_time = current_time;
 			float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
+
+			if (replaying) {
+				if (replay_frame >= replay.frames.size()) {
+					float total = std::chrono::duration< float >(current_time - replay_start).count();
+					std::cout << "Replay finished: " << replay.frames.size() << " frames in " << total << "s." << std::endl;
+					quit = true;
+					break;
+				}
+				float recorded = replay.frames[replay_frame].elapsed;
+				++replay_frame;
+				//at original speed, wait out the rest of the recorded frame time:
+				if (!config.replay_fast && elapsed < recorded) {
+					SDL_Delay(uint32_t((recorded - elapsed) * 1000.0f));
+					current_time = std::chrono::high_resolution_clock::now();
+				}
+				elapsed = recorded;
+			} else if (config.record_file != "") {
+				recording.add_frame(elapsed);
+			}
 			previous_time = current_time;
 
 			//if frames are taking a very long time to process,
 			//lag to avoid spiral of death:
-			elapsed = std::min(0.1f, elapsed);
+			accumulator = std::min(accumulator + elapsed, MaxStepsPerFrame * SimulationStep);
 
-			game->update(elapsed);
-			if (!game) break;
+			if (accumulator >= SimulationStep) {
+				auto update_begin = std::chrono::high_resolution_clock::now();
+				while (accumulator >= SimulationStep) {
+					game->update(SimulationStep);
+					accumulator -= SimulationStep;
+				}
+				auto update_end = end_phase(UpdatePhase, update_begin);
+				update_ms += std::chrono::duration< double, std::milli >(update_end - update_begin).count();
+			}
+			alpha = accumulator / SimulationStep;
 		}
 
-		{ //(3) call the game's "draw" function to produce output:
-			//clear the depth+color buffers and set some default state:
-			glClearColor(0.5, 0.5, 0.5, 0.0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glEnable(GL_DEPTH_TEST);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		//skip drawing (and swapping) when the previous frame is still accurate:
+		// (the profiler overlay changes every frame, so it always redraws)
+		schedule.published = !schedule.hidden
+			&& (schedule.force_redraw || game->needs_redraw || game->interpolating() || game->show_profiler);
+		if (!schedule.published) continue;
+
+		{ //(3) hand the frame to the render thread:
+			//stay no more than MaxFramesAhead frames ahead of the screen (this is what vsync paces):
+			while (published_sequence - presented_sequence.load(std::memory_order_acquire) >= MaxFramesAhead
+			    && !render_failed.load()) {
+				SDL_SemWaitTimeout(frame_presented, 100);
+			}
 
-			game->draw(drawable_size);
+			Game::FramePacket &frame = frames.write_slot();
+			frame = game->make_frame(drawable_size, alpha);
+			frame.sequence = ++published_sequence;
+			frame.update_ms = update_ms;
+			frames.publish();
+			SDL_SemPost(frame_published);
 		}
-
-		//Finally, wait until the recently-drawn frame is shown before doing it all again:
-		SDL_GL_SwapWindow(window);
+		game->needs_redraw = false;
+		schedule.force_redraw = false;
 	}
 
+	//stop the render thread and take the context back to free the game's GL resources:
+	render_quit.store(true);
+	SDL_SemPost(frame_published);
+	render_thread.join();
+	SDL_DestroySemaphore(frame_published);
+	SDL_DestroySemaphore(frame_presented);
+
+	SDL_GL_MakeCurrent(window, context);
+	game.reset();
+
+	report_timings();
+
 
 	//------------  teardown ------------
 
+	if (config.record_file != "") {
+		//close off any events (e.g. the final quit) that arrived after the last frame:
+		if (recording.pending_events != 0) {
+			recording.add_frame(0.0f);
+		}
+		try {
+			recording.save(config.record_file);
+			std::cout << "Saved recording of " << recording.frames.size() << " frames to '" << config.record_file << "'." << std::endl;
+		} catch (std::exception &e) {
+			std::cerr << "Failed to save recording: " << e.what() << std::endl;
+		}
+	}
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
@@ -0,0 +1,248 @@
+//mix-bench measures how fast the Mixer sums voices, with its SIMD kernel and
+// with the one-sample-at-a-time reference, and checks that both agree.
+// Usage: mix-bench [--buffers <n>] [--buffer <frames>] [--seed <n>]
+//
+// Throughput is given as voice-buffers mixed per millisecond of CPU, and as
+// the number of voices one core could keep playing in real time.
+// Also compares mixing from PCM with mixing from IMA-ADPCM (and reports what
+// decoding costs each voice), and times the load-time Resampler and measures
+// its error on a sine tone.
+
+#include "Mixer.hpp"
+#include "Adpcm.hpp"
+#include "Resampler.hpp"
+#include "PCG32.hpp"
+#include "parse_unsigned.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+int main(int argc, char **argv) {
+	struct {
+		uint32_t buffers = 2000;
+		uint32_t buffer = 512; //same as Game.cpp's device buffer
+		uint64_t seed = 0;
+	} config;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		try {
+			if (arg == "--buffers" && argi + 1 < argc) {
+				config.buffers = parse_unsigned< uint32_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--buffer" && argi + 1 < argc) {
+				config.buffer = std::max(1u, parse_unsigned< uint32_t >(argv[argi + 1]));
+				argi += 1;
+			} else if (arg == "--seed" && argi + 1 < argc) {
+				config.seed = parse_unsigned< uint64_t >(argv[argi + 1]);
+				argi += 1;
+			} else {
+				std::cerr << "Usage:\n\t" << argv[0] << " [--buffers <n>] [--buffer <frames>] [--seed <n>]" << std::endl;
+				return 1;
+			}
+		} catch (std::exception &) {
+			std::cerr << "Expecting a non-negative integer after " << arg << "." << std::endl;
+			return 1;
+		}
+	}
+
+	const uint32_t Rate = 44100;
+
+	//loud noise of a few odd lengths, so voices end mid-buffer and sums often clip:
+	PCG32 rng(config.seed);
+	std::vector< std::vector< int16_t > > noise;
+	for (uint32_t frames : { 44101u, 30011u, 65537u, 1009u }) {
+		std::vector< int16_t > samples(2 * frames);
+		for (auto &s : samples) s = int16_t(rng.next());
+		noise.emplace_back(std::move(samples));
+	}
+
+	std::cout << "mixing " << config.buffers << " buffers of " << config.buffer << " frames, "
+		<< Mixer::kernel_name() << " kernel vs. scalar:" << std::endl;
+
+	bool ok = true;
+	for (uint32_t voices : { 1u, 2u, 4u, 8u, 16u, 32u }) {
+		//two mixers fed the same commands, one mixed by each kernel:
+		Mixer mixers[2];
+		for (Mixer &mixer : mixers) {
+			for (auto const &samples : noise) mixer.add_sound(std::vector< int16_t >(samples));
+		}
+		struct Note {
+			uint32_t sound;
+			float volume, pan;
+			Mixer::Handle handles[2];
+		};
+		std::vector< Note > notes(voices);
+		PCG32 pick(config.seed, voices);
+		for (Note &note : notes) {
+			note.sound = pick.below(uint32_t(noise.size()));
+			note.volume = 0.25f + pick.below(1000) / 1000.0f;
+			note.pan = pick.below(2001) / 1000.0f - 1.0f;
+			note.handles[0] = note.handles[1] = 0;
+		}
+
+		std::vector< int16_t > out[2];
+		out[0].resize(2 * config.buffer);
+		out[1].resize(2 * config.buffer);
+		double seconds[2] = { 0.0, 0.0 };
+		uint64_t mismatched = 0;
+		for (uint32_t b = 0; b < config.buffers; ++b) {
+			for (uint32_t m = 0; m < 2; ++m) {
+				//keep every voice sounding (restarting notes as they finish):
+				for (Note &note : notes) {
+					if (!mixers[m].playing(note.handles[m])) {
+						note.handles[m] = mixers[m].play(note.sound, note.volume, note.pan);
+					}
+				}
+				auto before = std::chrono::high_resolution_clock::now();
+				if (m == 0) mixers[m].mix(out[m].data(), config.buffer);
+				else mixers[m].mix_scalar(out[m].data(), config.buffer);
+				auto after = std::chrono::high_resolution_clock::now();
+				seconds[m] += std::chrono::duration< double >(after - before).count();
+			}
+			for (uint32_t i = 0; i < out[0].size(); ++i) {
+				if (out[0][i] != out[1][i]) ++mismatched;
+			}
+		}
+
+		auto per_ms = [&](double s) {
+			return double(voices) * config.buffers / (s * 1000.0);
+		};
+		auto realtime = [&](double s) {
+			return double(voices) * config.buffers * config.buffer / Rate / s;
+		};
+		std::cout << "  " << (voices < 10 ? " " : "") << voices << " voices: "
+			<< Mixer::kernel_name() << " " << per_ms(seconds[0]) << " voice-buffers/ms (" << realtime(seconds[0]) << " real-time voices), "
+			<< "scalar " << per_ms(seconds[1]) << " voice-buffers/ms (" << realtime(seconds[1]) << "); speedup "
+			<< seconds[1] / seconds[0] << "x" << std::endl;
+		if (mismatched) {
+			std::cerr << "  " << mismatched << " samples differ between the scalar and " << Mixer::kernel_name() << " kernels!" << std::endl;
+			ok = false;
+		}
+	}
+
+	{ //the same sounds kept as 16-bit PCM vs. IMA-ADPCM (decoded while mixing), 32 voices at a time;
+		// mix (which decodes voices together) is checked against mix_scalar (one at a time):
+		const uint32_t Voices = 32;
+		Mixer mixers[3];
+		size_t bytes[2] = { 0, 0 };
+		for (auto const &samples : noise) {
+			uint32_t frames = uint32_t(samples.size() / 2);
+			std::vector< uint8_t > blocks = Adpcm::encode(samples.data(), frames);
+			bytes[0] += samples.size() * sizeof(int16_t);
+			bytes[1] += blocks.size();
+			mixers[0].add_sound(std::vector< int16_t >(samples));
+			mixers[1].add_adpcm(std::vector< uint8_t >(blocks), frames);
+			mixers[2].add_adpcm(std::move(blocks), frames);
+		}
+		double seconds[2] = { 0.0, 0.0 };
+		std::vector< int16_t > out[3];
+		std::vector< Mixer::Handle > handles[3];
+		for (uint32_t m = 0; m < 3; ++m) {
+			out[m].resize(2 * config.buffer);
+			handles[m].assign(Voices, 0);
+		}
+		uint64_t mismatched = 0;
+		for (uint32_t b = 0; b < config.buffers; ++b) {
+			for (uint32_t m = 0; m < 3; ++m) {
+				for (uint32_t v = 0; v < Voices; ++v) {
+					if (!mixers[m].playing(handles[m][v])) handles[m][v] = mixers[m].play(v % uint32_t(noise.size()), 0.5f);
+				}
+				if (m == 2) {
+					mixers[m].mix_scalar(out[m].data(), config.buffer);
+					continue;
+				}
+				auto before = std::chrono::high_resolution_clock::now();
+				mixers[m].mix(out[m].data(), config.buffer);
+				auto after = std::chrono::high_resolution_clock::now();
+				seconds[m] += std::chrono::duration< double >(after - before).count();
+			}
+			for (uint32_t i = 0; i < out[1].size(); ++i) {
+				if (out[1][i] != out[2][i]) ++mismatched;
+			}
+		}
+		std::cout << "  " << Voices << " voices from pcm: " << seconds[0] / config.buffers * 1.0e6 << "us/buffer (" << bytes[0] / 1024 << "k resident), "
+			<< "from adpcm: " << seconds[1] / config.buffers * 1.0e6 << "us/buffer (" << bytes[1] / 1024 << "k resident)" << std::endl;
+
+		//decoding alone, every voice together vs. one at a time, against how long one buffer lasts:
+		std::vector< Adpcm::Stream > streams[2];
+		std::vector< Adpcm::State > states[2];
+		std::vector< int16_t > decoded[2];
+		double decode_seconds[2] = { 0.0, 0.0 };
+		for (uint32_t m = 0; m < 2; ++m) {
+			streams[m].resize(Voices);
+			states[m].resize(2 * Voices);
+			decoded[m].resize(size_t(Voices) * 2 * config.buffer);
+			for (uint32_t v = 0; v < Voices; ++v) {
+				Adpcm::Stream &stream = streams[m][v];
+				stream.blocks = mixers[1].sounds[v % uint32_t(noise.size())].adpcm.data();
+				stream.first = 0;
+				stream.count = 0;
+				stream.state = &states[m][2 * v];
+				stream.out = &decoded[m][size_t(v) * 2 * config.buffer];
+			}
+		}
+		for (uint32_t b = 0; b < config.buffers; ++b) {
+			for (uint32_t m = 0; m < 2; ++m) {
+				for (uint32_t v = 0; v < Voices; ++v) {
+					Adpcm::Stream &stream = streams[m][v];
+					uint32_t frames = mixers[1].sounds[v % uint32_t(noise.size())].frames;
+					stream.first += stream.count;
+					if (stream.first == frames) stream.first = 0; //(restart, from the first block's header)
+					stream.count = std::min(config.buffer, frames - stream.first);
+				}
+				auto before = std::chrono::high_resolution_clock::now();
+				if (m == 0) Adpcm::decode(streams[m].data(), Voices);
+				else Adpcm::decode_scalar(streams[m].data(), Voices);
+				auto after = std::chrono::high_resolution_clock::now();
+				decode_seconds[m] += std::chrono::duration< double >(after - before).count();
+			}
+			if (decoded[0] != decoded[1]) ++mismatched;
+		}
+		double per_voice = decode_seconds[0] / config.buffers / Voices;
+		std::cout << "  adpcm decoding: " << Adpcm::kernel_name() << " " << decode_seconds[0] / config.buffers * 1.0e6
+			<< "us/buffer, one voice at a time " << decode_seconds[1] / config.buffers * 1.0e6 << "us/buffer ("
+			<< decode_seconds[1] / decode_seconds[0] << "x); " << per_voice * 1.0e6 << "us per voice, "
+			<< 100.0 * per_voice / (double(config.buffer) / Rate) << "% of the " << 1.0e3 * config.buffer / Rate << "ms a buffer lasts" << std::endl;
+		if (mismatched) {
+			std::cerr << "  " << mismatched << " samples (or buffers) differ between decoding voices together and one at a time!" << std::endl;
+			ok = false;
+		}
+	}
+
+	{ //load-time rate conversion of a three-second stereo sine, compared with the exact sine at the new rate:
+		const double Pi = 3.14159265358979323846;
+		const double Frequency = 1000.0;
+		for (auto rates : { std::make_pair(44100u, 48000u), std::make_pair(48000u, 44100u), std::make_pair(22050u, 44100u) }) {
+			uint32_t from = rates.first, to = rates.second;
+			uint32_t frames = 3 * from;
+			std::vector< float > sine(2 * frames);
+			for (uint32_t i = 0; i < frames; ++i) {
+				sine[2 * i] = sine[2 * i + 1] = float(0.5 * std::sin(2.0 * Pi * Frequency * i / from));
+			}
+			auto before = std::chrono::high_resolution_clock::now();
+			Resampler resampler(from, to);
+			std::vector< float > out = resampler.resample(sine.data(), frames, 2);
+			auto after = std::chrono::high_resolution_clock::now();
+
+			//(away from the ends, where the filter runs into the silence around the sound)
+			double signal = 0.0, error = 0.0;
+			uint32_t out_frames = uint32_t(out.size() / 2);
+			for (uint32_t j = out_frames / 4; j < 3 * out_frames / 4; ++j) {
+				double expected = 0.5 * std::sin(2.0 * Pi * Frequency * j / to);
+				signal += expected * expected;
+				error += (out[2 * j] - expected) * (out[2 * j] - expected);
+			}
+			std::cout << "  resample " << from << " -> " << to << ": " << std::chrono::duration< double, std::milli >(after - before).count()
+				<< "ms for 3s of stereo (" << resampler.phases << " phases x " << resampler.taps << " taps), SNR "
+				<< 10.0 * std::log10(signal / error) << "dB" << std::endl;
+		}
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <limits>
+#include <stdexcept>
+#include <cstdint>
+
+//parse a command-line count/seed as a non-negative decimal integer that fits in T.
+// Throws std::invalid_argument for anything but plain digits and std::out_of_range
+// for values too big for T (std::stoul/stoull would quietly wrap "-1" around, and
+// a uint32_t cast of their result would quietly truncate):
+template< typename T >
+T parse_unsigned(std::string const &text) {
+	static_assert(std::numeric_limits< T >::is_integer && !std::numeric_limits< T >::is_signed, "parse_unsigned wants an unsigned integer type");
+	if (text.empty()) throw std::invalid_argument("empty number");
+	uint64_t value = 0;
+	for (char c : text) {
+		if (c < '0' || c > '9') throw std::invalid_argument("'" + text + "' is not a non-negative integer");
+		uint64_t digit = uint64_t(c - '0');
+		if (value > (std::numeric_limits< T >::max() - digit) / 10) throw std::out_of_range("'" + text + "' is too large");
+		value = value * 10 + digit;
+	}
+	return T(value);
+}
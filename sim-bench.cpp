@@ -0,0 +1,429 @@
+//sim-bench runs the headless Simulation as fast as possible and reports throughput.
+// Usage: sim-bench [--ticks <n>] [--seed <n>] [--bots <n>] [--agents <n>]
+
+#include "Simulation.hpp"
+#include "Agents.hpp"
+#include "SpatialGrid.hpp"
+#include "CounterPlacement.hpp"
+#include "LevelPrefetch.hpp"
+#include "Jobs.hpp"
+#include "Bots.hpp"
+#include "SnapshotRing.hpp"
+#include "parse_unsigned.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <cstring>
+
+int main(int argc, char **argv) {
+	struct {
+		uint64_t ticks = 10000000;
+		uint64_t seed = 0;
+		uint32_t agents = 100000;
+		uint32_t bots = 1000;
+	} config;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		try {
+			if (arg == "--ticks" && argi + 1 < argc) {
+				config.ticks = parse_unsigned< uint64_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--seed" && argi + 1 < argc) {
+				config.seed = parse_unsigned< uint64_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--bots" && argi + 1 < argc) {
+				config.bots = parse_unsigned< uint32_t >(argv[argi + 1]);
+				argi += 1;
+			} else if (arg == "--agents" && argi + 1 < argc) {
+				config.agents = parse_unsigned< uint32_t >(argv[argi + 1]);
+				argi += 1;
+			} else {
+				std::cerr << "Usage:\n\t" << argv[0] << " [--ticks <n>] [--seed <n>] [--bots <n>] [--agents <n>]" << std::endl;
+				return 1;
+			}
+		} catch (std::exception &) {
+			std::cerr << "Expecting a non-negative integer after " << arg << "." << std::endl;
+			return 1;
+		}
+	}
+
+	const float SimulationStep = 1.0f / 120.0f; //same step main.cpp uses
+
+	Simulation sim(config.seed);
+	//input is a deterministic random walk: new key states every quarter second of simulated time:
+	PCG32 input(config.seed, 1);
+	const uint32_t TicksPerInput = 30;
+
+	uint64_t pickups = 0;
+	auto before = std::chrono::high_resolution_clock::now();
+	for (uint64_t tick = 0; tick < config.ticks; ++tick) {
+		if (tick % TicksPerInput == 0) {
+			uint32_t bits = input.next();
+			sim.controls.go_left = (bits & 1) != 0;
+			sim.controls.go_right = (bits & 2) != 0;
+			sim.controls.go_up = (bits & 4) != 0;
+			sim.controls.go_down = (bits & 8) != 0;
+		}
+		sim.update(SimulationStep);
+		if (sim.picked_up >= 0) ++pickups;
+	}
+	auto after = std::chrono::high_resolution_clock::now();
+	double seconds = std::chrono::duration< double >(after - before).count();
+
+	std::cout << config.ticks << " ticks in " << seconds << "s: "
+		<< (config.ticks / seconds) / 1.0e6 << " million ticks/second." << std::endl;
+	std::cout << "  pickups: " << pickups << ", sandwiches: " << sim.num_sandwiches << ", levels: " << sim.level
+		<< ", final avatar location: (" << sim.avatar_location.x << ", " << sim.avatar_location.y << ")" << std::endl;
+
+	{ //snapshot save/restore cost (e.g. for rollback or rewind):
+		const uint32_t Snapshots = 256;
+		const uint32_t Repeats = 1000000;
+		SnapshotRing< Simulation > history(Snapshots);
+
+		auto save_before = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < Repeats; ++i) {
+			sim.x_velocity = float(i); //(keeps the copies from being optimized away)
+			history.save(sim);
+		}
+		auto save_after = std::chrono::high_resolution_clock::now();
+
+		float checksum = 0.0f;
+		for (uint32_t i = 0; i < Repeats; ++i) {
+			history.restore(i % Snapshots, &sim);
+			checksum += sim.x_velocity;
+		}
+		auto restore_after = std::chrono::high_resolution_clock::now();
+
+		double save_ns = std::chrono::duration< double, std::nano >(save_after - save_before).count() / Repeats;
+		double restore_ns = std::chrono::duration< double, std::nano >(restore_after - save_after).count() / Repeats;
+		std::cout << "  snapshot (" << sizeof(Simulation) << " bytes): save " << save_ns << "ns, restore " << restore_ns
+			<< "ns (checksum " << checksum << ")" << std::endl;
+	}
+
+	{ //level transitions, generated in the finishing step vs. ahead of time as a job on a worker thread:
+		Jobs jobs;
+		const uint64_t Ticks = std::max< uint64_t >(config.ticks / 10, 1);
+		auto run = [&](bool prefetch, Simulation *out) {
+			Simulation s(config.seed);
+			LevelPrefetch level_prefetch(jobs);
+			PCG32 walk(config.seed, 1);
+			double transition_seconds = 0.0;
+			uint32_t transitions = 0;
+			for (uint64_t tick = 0; tick < Ticks; ++tick) {
+				if (tick % TicksPerInput == 0) {
+					uint32_t bits = walk.next();
+					s.controls.go_left = (bits & 1) != 0;
+					s.controls.go_right = (bits & 2) != 0;
+					s.controls.go_up = (bits & 4) != 0;
+					s.controls.go_down = (bits & 8) != 0;
+				}
+				if (prefetch) {
+					//(a played level lasts seconds, far longer than the worker needs; at benchmark speed it may not be done yet, so give it the time)
+					if (s.next_pickup + 1 == s.progression_length && !s.next_level_ready) {
+						level_prefetch.wait();
+					}
+					level_prefetch.update(&s);
+				}
+				uint32_t old_level = s.level;
+				auto before = std::chrono::high_resolution_clock::now();
+				s.update(SimulationStep);
+				auto after = std::chrono::high_resolution_clock::now();
+				if (s.level != old_level) {
+					transition_seconds += std::chrono::duration< double >(after - before).count();
+					++transitions;
+				}
+			}
+			*out = s;
+			return transition_seconds / std::max(transitions, 1u) * 1.0e6;
+		};
+		Simulation sync(config.seed), prefetched(config.seed);
+		double sync_us = run(false, &sync);
+		double prefetched_us = run(true, &prefetched);
+		std::cout << "  level transition step: " << sync_us << "us generating in place, "
+			<< prefetched_us << "us prefetched (" << sync.level << " levels)" << std::endl;
+		if (sync.level != prefetched.level || std::memcmp(sync.counters, prefetched.counters, sizeof(sync.counters)) != 0
+		 || sync.avatar_location != prefetched.avatar_location) {
+			std::cerr << "  prefetched levels differ from levels generated in place!" << std::endl;
+			return 1;
+		}
+	}
+
+	{ //counter placement on a big board (4096 edge cells):
+		const glm::uvec2 BigBoard = glm::uvec2(1026, 1026);
+		const uint32_t Levels = 100;
+		CounterPlacement placement;
+		PCG32 rng(config.seed, 4);
+		std::vector< glm::uvec2 > spots;
+		glm::vec2 avoid = glm::vec2(BigBoard / 2u);
+		uint64_t placed = 0;
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t l = 0; l < Levels; ++l) {
+			spots.clear();
+			placed += placement.place(BigBoard, 1.0f, -1U, &avoid, 1, 1.0f, rng, &spots);
+		}
+		auto after = std::chrono::high_resolution_clock::now();
+		double ms = std::chrono::duration< double, std::milli >(after - before).count() / Levels;
+		std::cout << "  counter placement (" << CounterPlacement::edge_cells(BigBoard) << " edge cells): "
+			<< ms << "ms per level, " << placed / Levels << " counters" << std::endl;
+	}
+
+	if (config.bots > 0) { //bots, each playing its own seed for a simulated minute:
+		const uint32_t BotTicks = 120 * 60;
+		std::vector< Simulation > games;
+		std::vector< BotFields > fields(config.bots);
+		games.reserve(config.bots);
+		for (uint32_t b = 0; b < config.bots; ++b) {
+			games.emplace_back(config.seed + b);
+		}
+
+		uint64_t bot_pickups = 0;
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t tick = 0; tick < BotTicks; ++tick) {
+			for (uint32_t b = 0; b < config.bots; ++b) {
+				fields[b].drive(&games[b]);
+				games[b].update(SimulationStep);
+				if (games[b].picked_up >= 0) ++bot_pickups;
+			}
+		}
+		auto after = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration< double >(after - before).count();
+
+		uint32_t idle_bots = 0;
+		uint64_t sandwiches = 0;
+		for (Simulation const &g : games) {
+			if (g.num_sandwiches == 0) ++idle_bots;
+			sandwiches += g.num_sandwiches;
+		}
+		std::cout << "  bots (" << config.bots << " x " << BotTicks << " ticks): "
+			<< (double(config.bots) * BotTicks / seconds) / 1.0e6 << " million bot-ticks/second, "
+			<< double(sandwiches) / config.bots << " sandwiches per bot-minute (" << bot_pickups << " pickups)" << std::endl;
+		if (idle_bots) {
+			std::cerr << "  " << idle_bots << " bots made no sandwiches in a minute!" << std::endl;
+			return 1;
+		}
+	}
+
+	if (config.agents > 0) { //multi-agent movement, SIMD kernel vs. one-at-a-time:
+		const uint32_t AgentTicks = 1200; //ten seconds of simulated time
+		const glm::uvec2 board_size = sim.board_size;
+
+		auto run = [&](bool simd, Agents *agents) {
+			agents->resize(config.agents, glm::vec2(4.0f, 4.0f));
+			PCG32 agent_input(config.seed, 2);
+			double seconds = 0.0;
+			for (uint32_t tick = 0; tick < AgentTicks; ++tick) {
+				if (tick % TicksPerInput == 0) {
+					for (uint32_t i = 0; i < agents->count; ++i) {
+						agents->controls[i] = uint8_t(agent_input.next() & 0xf);
+					}
+				}
+				auto before = std::chrono::high_resolution_clock::now();
+				if (simd) agents->update(SimulationStep, board_size);
+				else agents->update_scalar(SimulationStep, board_size);
+				auto after = std::chrono::high_resolution_clock::now();
+				seconds += std::chrono::duration< double >(after - before).count();
+			}
+			return (double(agents->count) * AgentTicks / seconds) / 1.0e6;
+		};
+
+		Agents scalar, simd;
+		double scalar_rate = run(false, &scalar);
+		double simd_rate = run(true, &simd);
+
+		uint32_t mismatched = 0;
+		for (uint32_t i = 0; i < config.agents; ++i) {
+			if (scalar.x[i] != simd.x[i] || scalar.y[i] != simd.y[i]
+			 || scalar.x_velocity[i] != simd.x_velocity[i] || scalar.y_velocity[i] != simd.y_velocity[i]) {
+				++mismatched;
+			}
+		}
+
+		std::cout << "  agents (" << config.agents << " x " << AgentTicks << " ticks, one core): scalar "
+			<< scalar_rate << ", " << Agents::kernel_name() << " " << simd_rate
+			<< " million agent-ticks/second (" << simd_rate / scalar_rate << "x)" << std::endl;
+		if (mismatched) {
+			std::cerr << "  " << mismatched << " agents differ between the scalar and " << Agents::kernel_name() << " kernels!" << std::endl;
+			return 1;
+		}
+
+		{ //every agent bot-driven on one shared layout (one set of fields for all of them):
+			BotFields shared;
+			shared.update(sim);
+			SpatialGrid counters;
+			float cx[Simulation::CounterCount], cy[Simulation::CounterCount];
+			for (uint32_t c = 0; c < Simulation::CounterCount; ++c) {
+				cx[c] = float(sim.counters[c].location.x);
+				cy[c] = float(sim.counters[c].location.y);
+			}
+			counters.build(board_size, Simulation::CounterCount, cx, cy);
+
+			Agents bots;
+			bots.resize(config.agents, glm::vec2(sim.avatar_location));
+			const uint32_t BotAgentTicks = 120;
+			uint64_t agent_pickups = 0;
+			auto before = std::chrono::high_resolution_clock::now();
+			for (uint32_t tick = 0; tick < BotAgentTicks; ++tick) {
+				shared.drive(&bots, sim);
+				bots.update(SimulationStep, board_size);
+				agent_pickups += bots.pickup(sim, counters);
+			}
+			auto after = std::chrono::high_resolution_clock::now();
+			double seconds = std::chrono::duration< double >(after - before).count();
+			std::cout << "  bot-driven agents (" << config.agents << " x " << BotAgentTicks << " ticks): "
+				<< (double(config.agents) * BotAgentTicks / seconds) / 1.0e6 << " million agent-ticks/second ("
+				<< agent_pickups << " pickups)" << std::endl;
+		}
+
+		//pickups on boards with every edge tile holding a counter (the key counters, then the plain
+		// ones Game draws in the gaps): counters found through a grid vs. testing every counter.
+		// The grid's cost per agent should stay flat as the counters grow; testing them all shouldn't:
+		const uint32_t PickupTicks = 120;
+		const uint32_t PickupAgents = std::min(config.agents, 10000u);
+
+		//'agents' scattered over 'board' at random, moving at random:
+		auto scatter = [&config](Agents *agents, uint32_t count, glm::uvec2 board) {
+			agents->resize(count, glm::vec2(0.0f, 0.0f));
+			PCG32 place(config.seed, 4);
+			for (uint32_t i = 0; i < count; ++i) {
+				agents->x[i] = float(1 + place.below(board.x - 2));
+				agents->y[i] = float(1 + place.below(board.y - 2));
+			}
+		};
+
+		for (uint32_t side : { 9u, 33u, 129u, 513u }) {
+			glm::uvec2 board(side, side);
+			Simulation::Level layout = Simulation::make_level(config.seed, 0, board, glm::vec2(board / 2u), 1.0f);
+			std::vector< float > cx, cy;
+			for (auto const &counter : layout.counters) {
+				cx.emplace_back(float(counter.location.x));
+				cy.emplace_back(float(counter.location.y));
+			}
+			for (uint32_t y = 0; y < side; ++y) {
+				for (uint32_t x = 0; x < side; ++x) {
+					if (x != 0 && y != 0 && x + 1 != side && y + 1 != side) continue;
+					bool occupied = false;
+					for (auto const &counter : layout.counters) {
+						if (counter.location.x == x && counter.location.y == y) occupied = true;
+					}
+					if (occupied) continue;
+					cx.emplace_back(float(x));
+					cy.emplace_back(float(y));
+				}
+			}
+			uint32_t counter_count = uint32_t(cx.size());
+			SpatialGrid counter_grid;
+			counter_grid.build(board, counter_count, cx.data(), cy.data());
+
+			//(counter indices below CounterCount are the key counters, as in level_progression)
+			auto brute_force_pickup = [&](Agents *agents) {
+				uint32_t pickups = 0;
+				for (uint32_t i = 0; i < agents->count; ++i) {
+					uint8_t wanted = sim.level_progression[agents->next_pickup[i]];
+					bool found = false;
+					for (uint32_t c = 0; c < counter_count; ++c) {
+						if (adjacent(glm::vec2(cx[c], cy[c]), glm::vec2(agents->x[i], agents->y[i]), 0.5f) && c == wanted) found = true;
+					}
+					if (found) {
+						++pickups;
+						if (++agents->next_pickup[i] == sim.progression_length) agents->next_pickup[i] = 0;
+					}
+				}
+				return pickups;
+			};
+
+			Agents with_grid, without_grid;
+			scatter(&with_grid, PickupAgents, board);
+			scatter(&without_grid, PickupAgents, board);
+			PCG32 agent_input(config.seed, 3);
+			uint64_t grid_pickups = 0, brute_pickups = 0;
+			double grid_seconds = 0.0, brute_seconds = 0.0;
+			for (uint32_t tick = 0; tick < PickupTicks; ++tick) {
+				if (tick % TicksPerInput == 0) {
+					for (uint32_t i = 0; i < PickupAgents; ++i) {
+						with_grid.controls[i] = without_grid.controls[i] = uint8_t(agent_input.next() & 0xf);
+					}
+				}
+				with_grid.update(SimulationStep, board);
+				without_grid.update(SimulationStep, board);
+
+				auto t0 = std::chrono::high_resolution_clock::now();
+				grid_pickups += with_grid.pickup(sim, counter_grid);
+				auto t1 = std::chrono::high_resolution_clock::now();
+				brute_pickups += brute_force_pickup(&without_grid);
+				auto t2 = std::chrono::high_resolution_clock::now();
+
+				grid_seconds += std::chrono::duration< double >(t1 - t0).count();
+				brute_seconds += std::chrono::duration< double >(t2 - t1).count();
+			}
+			double per_agent = 1.0e9 / (double(PickupAgents) * PickupTicks);
+			std::cout << "  pickups (" << PickupAgents << " agents x " << PickupTicks << " ticks, " << side << "x" << side
+				<< " board, " << counter_count << " counters): grid " << grid_seconds * per_agent << "ns/agent, all counters "
+				<< brute_seconds * per_agent << "ns/agent (" << brute_seconds / grid_seconds << "x; " << grid_pickups << " pickups)" << std::endl;
+			if (grid_pickups != brute_pickups) {
+				std::cerr << "  grid found " << grid_pickups << " pickups but testing all counters found " << brute_pickups << "!" << std::endl;
+				return 1;
+			}
+		}
+
+		//agents near each other: a grid of the agents rebuilt every tick, then one batched query for every
+		// agent's neighbours. Both are linear in the agents, so on a board that grows with them (about
+		// two tiles per agent, so they stay as crowded) the cost per agent should stay flat:
+		for (uint32_t agent_count = std::max(1u, config.agents / 100); ; agent_count *= 10) {
+			agent_count = std::min(agent_count, config.agents);
+			uint32_t crowd_side = std::max(9u, uint32_t(std::ceil(std::sqrt(2.0 * agent_count))));
+			const glm::uvec2 CrowdBoard = glm::uvec2(crowd_side, crowd_side);
+			Agents crowd;
+			scatter(&crowd, agent_count, CrowdBoard);
+			SpatialGrid agent_grid;
+			std::vector< uint32_t > hit_start, hits;
+			PCG32 agent_input(config.seed, 5);
+			uint64_t neighbours = 0;
+			double build_seconds = 0.0, query_seconds = 0.0;
+			for (uint32_t tick = 0; tick < PickupTicks; ++tick) {
+				if (tick % TicksPerInput == 0) {
+					for (uint32_t i = 0; i < agent_count; ++i) {
+						crowd.controls[i] = uint8_t(agent_input.next() & 0xf);
+					}
+				}
+				crowd.update(SimulationStep, CrowdBoard);
+
+				auto t0 = std::chrono::high_resolution_clock::now();
+				agent_grid.build(CrowdBoard, agent_count, crowd.x.data(), crowd.y.data());
+				auto t1 = std::chrono::high_resolution_clock::now();
+				agent_grid.query_adjacent(agent_count, crowd.x.data(), crowd.y.data(), 0.0f, &hit_start, &hits);
+				auto t2 = std::chrono::high_resolution_clock::now();
+
+				build_seconds += std::chrono::duration< double >(t1 - t0).count();
+				query_seconds += std::chrono::duration< double >(t2 - t1).count();
+				neighbours += hits.size() - agent_count; //(every agent is adjacent to itself)
+			}
+			double per_agent = 1.0e9 / (double(agent_count) * PickupTicks);
+			std::cout << "  neighbours (" << agent_count << " agents x " << PickupTicks << " ticks, " << crowd_side << "x" << crowd_side
+				<< " board): agent grid rebuild "
+				<< build_seconds * per_agent << "ns/agent, batched query " << query_seconds * per_agent << "ns/agent ("
+				<< double(neighbours) / (double(agent_count) * PickupTicks) << " neighbours/agent)" << std::endl;
+
+			//check the last tick against testing every pair (while that's affordable):
+			if (agent_count <= 10000) {
+				uint64_t pairs = 0;
+				for (uint32_t i = 0; i < agent_count; ++i) {
+					for (uint32_t j = 0; j < agent_count; ++j) {
+						if (adjacent(glm::vec2(crowd.x[j], crowd.y[j]), glm::vec2(crowd.x[i], crowd.y[i]), 0.0f)) ++pairs;
+					}
+				}
+				if (pairs != hits.size()) {
+					std::cerr << "  grid found " << hits.size() << " adjacent pairs but testing every pair found " << pairs << "!" << std::endl;
+					return 1;
+				}
+			}
+			if (agent_count == config.agents) break;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+
+#Packs a .wav file into the IMA-ADPCM sound format read by Game.cpp (see Adpcm.hpp):
+#python3 encode-adpcm.py <infile.wav> <outfile.adpcm>
+
+import sys
+import struct
+import wave
+
+if len(sys.argv) != 3:
+	print("\n\nUsage:\npython3 encode-adpcm.py <infile.wav> <outfile.adpcm>\nConverts a PCM .wav file to 16-bit stereo and packs it as IMA-ADPCM (4 bits per sample).\n")
+	exit(1)
+
+infile = sys.argv[1]
+outfile = sys.argv[2]
+
+BLOCK_FRAMES = 1024
+BLOCK_BYTES = 2 * 4 + BLOCK_FRAMES
+
+STEP_TABLE = [
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+	253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+	1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+	3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+	12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+]
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+#---- read samples, as 16-bit stereo ----
+
+with wave.open(infile, 'rb') as w:
+	channels = w.getnchannels()
+	width = w.getsampwidth()
+	rate = w.getframerate()
+	frames = w.getnframes()
+	raw = w.readframes(frames)
+
+if channels not in (1, 2):
+	print("Expecting a mono or stereo file, '" + infile + "' has " + str(channels) + " channels.")
+	exit(1)
+
+def sample(i):
+	b = raw[i * width:(i + 1) * width]
+	if width == 1:
+		return (b[0] - 128) << 8 #8-bit .wav is unsigned
+	v = int.from_bytes(b, 'little', signed=True)
+	if width > 2:
+		#round to 16 bits:
+		shift = 8 * (width - 2)
+		v = min(32767, (v + (1 << (shift - 1))) >> shift)
+	return v
+
+left = []
+right = []
+for f in range(0, frames):
+	left.append(sample(f * channels))
+	right.append(sample(f * channels + channels - 1))
+
+#---- encode (same as Adpcm::encode) ----
+
+def encode_block(samples, state, nibbles):
+	predictor, index = state
+	for i in range(0, len(samples)):
+		s = STEP_TABLE[index]
+		diff = samples[i] - predictor
+		nibble = 0
+		if diff < 0:
+			nibble = 8
+			diff = -diff
+		if diff >= s:
+			nibble |= 4
+			diff -= s
+		s >>= 1
+		if diff >= s:
+			nibble |= 2
+			diff -= s
+		s >>= 1
+		if diff >= s:
+			nibble |= 1
+
+		#decode it, to track the decoder's state:
+		s = STEP_TABLE[index]
+		delta = s >> 3
+		if nibble & 4: delta += s
+		if nibble & 2: delta += s >> 1
+		if nibble & 1: delta += s >> 2
+		if nibble & 8: delta = -delta
+		predictor = max(-32768, min(32767, predictor + delta))
+		index = max(0, min(88, index + INDEX_TABLE[nibble]))
+
+		nibbles[i // 2] |= nibble << (4 * (i % 2))
+	return (predictor, index)
+
+data = b''
+states = [(0, 0), (0, 0)]
+for begin in range(0, frames, BLOCK_FRAMES):
+	header = b''
+	for c in range(0, 2):
+		header += struct.pack('<hBB', states[c][0], states[c][1], 0)
+	body = b''
+	for c, samples in enumerate((left, right)):
+		nibbles = bytearray(BLOCK_FRAMES // 2)
+		states[c] = encode_block(samples[begin:begin + BLOCK_FRAMES], states[c], nibbles)
+		body += bytes(nibbles)
+	data += header + body
+	assert(len(header + body) == BLOCK_BYTES)
+
+#---- write chunks (as write_chunk.hpp does) ----
+
+with open(outfile, 'wb') as out:
+	out.write(b'adp0' + struct.pack('<I', 8) + struct.pack('<II', rate, frames))
+	out.write(b'adb0' + struct.pack('<I', len(data)) + data)
+
+print("Wrote " + outfile + ": " + str(frames) + " frames at " + str(rate) + "Hz, " + str(len(data)) + " bytes (" + str(frames * 4) + " as 16-bit PCM).")
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <cstring>
+#include <cassert>
+
+//write_chunk writes a vector of structures prefixed by a magic number and size,
+// in the format expected by read_chunk:
+template< typename T >
+void write_chunk(std::string const &magic, std::vector< T > const &from, std::ostream *_to) {
+	assert(_to);
+	auto &to = *_to;
+
+	if (magic.size() != 4) {
+		throw std::runtime_error("Chunk magic must be four characters.");
+	}
+
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	ChunkHeader header;
+	std::memcpy(header.magic, magic.data(), 4);
+	header.size = uint32_t(from.size() * sizeof(T));
+
+	to.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	to.write(reinterpret_cast< char const * >(from.data()), from.size() * sizeof(T));
+}